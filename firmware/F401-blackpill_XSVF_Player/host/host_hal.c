@@ -0,0 +1,341 @@
+/*
+ * host_hal.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "jtag_pins.h"
+#include "jtag_dma.h"
+#include "host_hal.h"
+
+#define PIN(line)  ((line) & 0xffU)
+#define PORT(line) ((line) >> 8)
+#define JTAG_OUT   (BSRR_SET(TCK_Pin) | BSRR_SET(TMS_Pin) | BSRR_SET(TDI_Pin))
+
+HOST_COREDEBUG_ST host_coredebug;
+static HOST_DWT_ST dwt;
+static HOST_STATS_ST stats;
+static TAP_SIM_ST *tap;
+static TRACE_ST *trace;
+static void (*on_wait)(void);
+
+/* GPIOC: output latch and the pins in output mode, the others are pulled down */
+static uint32_t odr;
+static uint32_t outputs;
+static uint32_t pins;       // levels the TAP sees
+
+/* SPI1: TCK and TDI as SCK and MOSI drive them, and which of them it drives */
+SPIDriver SPID1;
+static uint32_t spi_out;
+static uint32_t spi_lines;
+
+/* the last BSRR store, applied with the next access */
+static uint32_t slot;
+static bool pending;
+static uint64_t slot_time;
+
+static void pins_changed(uint64_t when){
+  uint32_t now = ((odr & outputs) | (spi_out & spi_lines)) & JTAG_OUT;
+  uint32_t rise = now & ~pins, fall = pins & ~now;
+
+  pins = now;
+  if (!tap) return;
+  tap->now = when;
+  if (rise & BSRR_SET(TCK_Pin)) {
+    bool tms = (now & BSRR_SET(TMS_Pin)) != 0, tdi = (now & BSRR_SET(TDI_Pin)) != 0;
+    if (trace) trace_edge(trace, tms, tdi, tap->tdo, tap->state);
+    tap_rise(tap, tms, tdi);
+  } else if (fall & BSRR_SET(TCK_Pin)) {
+    tap_fall(tap);
+  }
+}
+
+static void bsrr_apply(uint32_t word, uint64_t when){
+  odr = (odr & ~(word >> 16)) | (word & 0xffffU);
+  pins_changed(when);
+}
+
+void host_flush(void){
+  if (pending) {
+    pending = false;
+    bsrr_apply(slot, slot_time);
+  }
+}
+
+volatile uint32_t * host_bsrr(void){
+  host_flush();
+  stats.cycles += HOST_CYC_STORE;
+  stats.stores++;
+  slot_time = stats.cycles;
+  pending = true;
+  return &slot;
+}
+
+uint32_t host_tdo(void){
+  host_flush();
+  stats.cycles += HOST_CYC_LOAD;
+  stats.loads++;
+  return tap ? tap->tdo : 0;
+}
+
+HOST_DWT_ST * host_dwt(void){
+  host_flush();
+  stats.cycles += HOST_CYC_DWT;
+  dwt.CYCCNT = (uint32_t)stats.cycles;
+  return &dwt;
+}
+
+void host_nop(void){
+  stats.cycles += HOST_CYC_NOP;
+  stats.nops++;
+}
+
+void palSetLine(ioline_t line){
+  host_flush();
+  stats.cycles += HOST_CYC_STORE;
+  if (PORT(line) == GPIOC) bsrr_apply(BSRR_SET(PIN(line)), stats.cycles);
+}
+
+void palClearLine(ioline_t line){
+  host_flush();
+  stats.cycles += HOST_CYC_STORE;
+  if (PORT(line) == GPIOC) bsrr_apply(BSRR_RESET(PIN(line)), stats.cycles);
+}
+
+uint32_t palReadLine(ioline_t line){
+  if (PORT(line) == GPIOB && PIN(line) == TDO_Pin) return host_tdo() ? PAL_HIGH : PAL_LOW;
+  host_flush();
+  return (odr >> PIN(line)) & 1;
+}
+
+void palSetLineMode(ioline_t line, iomode_t mode){
+  uint32_t spi_pin = 0;
+
+  host_flush();
+  if (line == PAL_LINE(GPIOA, 5U)) spi_pin = BSRR_SET(TCK_Pin);
+  if (line == PAL_LINE(GPIOA, 7U)) spi_pin = BSRR_SET(TDI_Pin);
+  if (spi_pin) {
+    if (mode & PAL_MODE_ALTERNATE(0)) spi_lines |= spi_pin;
+    else spi_lines &= ~spi_pin;
+  }
+  else if (PORT(line) == GPIOC) {
+    if (mode & PAL_MODE_OUTPUT_PUSHPULL) outputs |= BSRR_SET(PIN(line));
+    else outputs &= ~BSRR_SET(PIN(line));
+  }
+  else return;
+  pins_changed(stats.cycles);
+}
+
+void spiStart(SPIDriver *spip, const SPIConfig *config){
+  spip->config = config;
+}
+
+void spiStop(SPIDriver *spip){
+  spip->config = NULL;
+}
+
+/* MOSI changes with the falling edge, MISO is sampled with the rising one */
+void spiExchange(SPIDriver *spip, size_t n, const void *txbuf, void *rxbuf){
+  const uint8_t *tx = txbuf;
+  uint8_t *rx = rxbuf;
+  uint32_t half, i, bit;
+  uint8_t in;
+
+  chDbgAssert(spip->config && (spip->config->cr1 & SPI_CR1_LSBFIRST), "SPI not started LSB first");
+  half = (uint32_t)(STM32_SYSCLK / STM32_PCLK2) << ((spip->config->cr1 / SPI_CR1_BR_0) & 7);
+  host_flush();
+  for (i=0; i<n; i++){
+    in = 0;
+    for (bit=0; bit<8; bit++){
+      spi_out = (tx[i] >> bit & 1) ? BSRR_SET(TDI_Pin) : 0;
+      pins_changed(stats.cycles);
+      stats.cycles += half;
+      if (tap && tap->tdo) in |= 1U << bit;
+      spi_out |= BSRR_SET(TCK_Pin);
+      pins_changed(stats.cycles);
+      stats.cycles += half;
+      spi_out &= ~BSRR_SET(TCK_Pin);
+      pins_changed(stats.cycles);
+    }
+    if (rx) rx[i] = in;
+  }
+}
+
+void spiSend(SPIDriver *spip, size_t n, const void *txbuf){
+  spiExchange(spip, n, txbuf, NULL);
+}
+
+/* The TAP behind the pins, NULL leaves them unconnected. */
+void host_attach(TAP_SIM_ST *t){
+  host_flush();
+  tap = t;
+  pins = odr & outputs & JTAG_OUT;
+  if (tap) tap->now = stats.cycles;
+}
+
+/* Records the edges into trace from now on, NULL stops. */
+void host_trace(TRACE_ST *t){
+  host_flush();
+  trace = t;
+}
+
+void host_get_stats(HOST_STATS_ST *s){
+  host_flush();
+  *s = stats;
+}
+
+/*
+ * One thread only: a wait can't be ended by anyone else, unless the
+ * caller stands in for the other side in fn, e.g. the receiver filling
+ * the stream ring. fn runs whenever a semaphore wait would block.
+ */
+void host_on_wait(void (*fn)(void)){
+  on_wait = fn;
+}
+
+void chBSemObjectInit(binary_semaphore_t *bsp, bool taken){
+  bsp->cnt = taken ? 0 : 1;
+}
+
+void chBSemReset(binary_semaphore_t *bsp, bool taken){
+  bsp->cnt = taken ? 0 : 1;
+}
+
+void chBSemSignal(binary_semaphore_t *bsp){
+  bsp->cnt = 1;
+}
+
+msg_t chBSemWaitTimeout(binary_semaphore_t *bsp, sysinterval_t timeout){
+  if ((bsp->cnt == 0) && on_wait) on_wait();
+  if (bsp->cnt == 0) return MSG_TIMEOUT;
+  bsp->cnt = 0;
+  return MSG_OK;
+}
+
+void chFifoObjectInit(objects_fifo_t *ofp, size_t objsize, size_t objn, void *objbuf, msg_t *msgbuf){
+  size_t i;
+
+  ofp->objs = objbuf;
+  ofp->objsize = objsize;
+  ofp->objn = objn;
+  ofp->msgbuf = msgbuf;
+  ofp->rd = 0;
+  ofp->cnt = 0;
+  ofp->free = NULL;
+  for (i=objn; i>0; i--){
+    chFifoReturnObject(ofp, &ofp->objs[(i - 1) * objsize]);
+  }
+}
+
+void *chFifoTakeObjectTimeout(objects_fifo_t *ofp, sysinterval_t timeout){
+  void *objp = ofp->free;
+
+  if (objp) memcpy(&ofp->free, objp, sizeof(void *));
+  return objp;
+}
+
+void chFifoReturnObject(objects_fifo_t *ofp, void *objp){
+  chDbgAssert(((uint8_t *)objp >= ofp->objs) &&
+              ((uint8_t *)objp < ofp->objs + ofp->objn * ofp->objsize), "not an object of this FIFO");
+  memcpy(objp, &ofp->free, sizeof(void *));
+  ofp->free = objp;
+}
+
+void chFifoSendObject(objects_fifo_t *ofp, void *objp){
+  chDbgAssert(ofp->cnt < ofp->objn, "mailbox full");
+  ofp->msgbuf[(ofp->rd + ofp->cnt++) % ofp->objn] = (msg_t)(((uint8_t *)objp - ofp->objs) / ofp->objsize);
+}
+
+msg_t chFifoReceiveObjectTimeout(objects_fifo_t *ofp, void **objpp, sysinterval_t timeout){
+  if (ofp->cnt == 0) return MSG_TIMEOUT;
+  *objpp = &ofp->objs[ofp->msgbuf[ofp->rd] * ofp->objsize];
+  ofp->rd = (ofp->rd + 1) % ofp->objn;
+  ofp->cnt--;
+  return MSG_OK;
+}
+
+#if JTAG_DMA_CLOCK
+/*
+ * The free-running TCK of the waits (jtag_dma.c): every TIM1 update
+ * stores the next of two BSRR words, TCK low, then high, while the
+ * thread sleeps.
+ */
+static uint32_t clock_half = XSVF_WAVE_HALF_TICKS;
+static bool clock_on;
+static bool clock_high;
+static uint64_t clock_next;
+
+static void clock_run(uint64_t until){
+  while (clock_on && (clock_next <= until)){
+    bsrr_apply(clock_high ? BSRR_SET(TCK_Pin) : BSRR_RESET(TCK_Pin), clock_next);
+    clock_high = !clock_high;
+    clock_next += (uint64_t)clock_half * STM32_SYSCLK / STM32_TIMCLK2;
+  }
+}
+
+void jtag_dma_init(void){
+}
+
+uint32_t jtag_dma_rate(uint32_t hz, bool apply){
+  uint32_t half = XSVF_WAVE_HALF_TICKS;
+
+  if (hz) {
+    half = (STM32_TIMCLK2 + 2 * hz - 1) / (2 * hz);
+    if (half < XSVF_WAVE_MIN_HALF) half = XSVF_WAVE_MIN_HALF;
+    if (half > 0x10000) half = 0x10000;
+  }
+  if (apply) clock_half = half;
+  return STM32_TIMCLK2 / (2 * half);
+}
+
+void jtag_dma_clock_start(void){
+  host_flush();
+  stats.cycles += HOST_CYC_STORE;
+  clock_on = true;
+  clock_high = false;
+  clock_next = stats.cycles;
+}
+
+void jtag_dma_clock_stop(void){
+  host_flush();
+  clock_run(stats.cycles);
+  clock_on = false;
+  stats.cycles += HOST_CYC_STORE;
+  bsrr_apply(BSRR_RESET(TCK_Pin), stats.cycles);
+}
+#endif
+
+/* TCK runs on if the timer clocks it, else it stands still */
+void chThdSleep(sysinterval_t time){
+  uint64_t c = (uint64_t)time * (STM32_SYSCLK / CH_CFG_ST_FREQUENCY);
+
+  host_flush();
+  stats.cycles += c;
+  stats.sleep += c;
+#if JTAG_DMA_CLOCK
+  clock_run(stats.cycles);
+#endif
+}
+
+systime_t chVTGetSystemTime(void){
+  return (systime_t)(stats.cycles / (STM32_SYSCLK / CH_CFG_ST_FREQUENCY));
+}
+
+int chprintf(BaseSequentialStream *chp, const char *fmt, ...){
+  char buf[256];
+  va_list ap;
+  int n;
+
+  va_start(ap, fmt);
+  n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (n < 0) return n;
+  if (n >= (int)sizeof(buf)) n = sizeof(buf) - 1;
+  streamWrite(chp, (const uint8_t *)buf, n);
+  return n;
+}
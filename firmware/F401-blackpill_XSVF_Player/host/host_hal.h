@@ -0,0 +1,47 @@
+/*
+ * host_hal.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_HOST_HAL_H_
+#define HOST_HOST_HAL_H_
+
+#include <stdint.h>
+#include "tap_sim.h"
+#include "trace.h"
+
+/*
+ * Simulated CPU cycles per access. Only the pin accesses, the NOPs of
+ * wait_nops(), the DWT reads and the sleeps take time, the code in between
+ * is free. So the simulated time is a lower bound, which tracks the pin
+ * bound paths (shift kernels, TMS bursts, waits) of the real player.
+ */
+#if !defined(HOST_CYC_STORE)
+#define HOST_CYC_STORE  2   // BSRR store
+#endif
+#if !defined(HOST_CYC_LOAD)
+#define HOST_CYC_LOAD   3   // TDO read through the bit-band alias or the IDR
+#endif
+#if !defined(HOST_CYC_NOP)
+#define HOST_CYC_NOP    1
+#endif
+#if !defined(HOST_CYC_DWT)
+#define HOST_CYC_DWT    1   // CYCCNT read
+#endif
+
+typedef struct {
+  uint64_t cycles;        // simulated CPU cycles since start-up
+  uint64_t sleep;         // of them asleep in chThdSleep()
+  uint64_t stores;
+  uint64_t loads;
+  uint64_t nops;
+} HOST_STATS_ST;
+
+void host_attach(TAP_SIM_ST *tap);
+void host_on_wait(void (*fn)(void));
+void host_trace(TRACE_ST *trace);
+void host_flush(void);
+void host_get_stats(HOST_STATS_ST *s);
+
+#endif /* HOST_HOST_HAL_H_ */
@@ -0,0 +1,100 @@
+/*
+ * shift_bench.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jtag.h"
+#include "jtag_spi.h"
+#include "host_hal.h"
+#include "tap_sim.h"
+
+/*
+ * Cost per bit of the bit-bang reference and of every shift kernel in the
+ * host cost model: simulated cycles, BSRR stores, TDO loads and NOPs,
+ * at full speed and at the power-up tck_wait.
+ */
+#define BENCH_BITS 4096
+
+enum { REF, REF_IO, REF_EXIT, OUT, OUT_EXIT, IO, IO_EXIT, SPI, SPI_IO, VARIANTS };
+
+static const char *const names[VARIANTS] = {
+  "jtag_shift_ref", "jtag_shift_ref tdo", "jtag_shift_ref exit",
+  "jtag_shift_out", "jtag_shift_out_exit", "jtag_shift_io", "jtag_shift_io_exit",
+  "jtag_spi_shift", "jtag_spi_shift tdo"
+};
+
+static uint8_t data[BENCH_BITS / 8], tdo[BENCH_BITS / 8];
+
+static void shift(int v){
+  switch (v) {
+  case REF:       jtag_shift_ref(data, NULL, BENCH_BITS, 0); break;
+  case REF_IO:    jtag_shift_ref(data, tdo, BENCH_BITS, 0); break;
+  case REF_EXIT:  jtag_shift_ref(data, NULL, BENCH_BITS, 1); break;
+  case OUT:       jtag_shift_out(data, BENCH_BITS); break;
+  case OUT_EXIT:  jtag_shift_out_exit(data, BENCH_BITS); break;
+  case IO:        jtag_shift_io(data, tdo, BENCH_BITS); break;
+  case IO_EXIT:   jtag_shift_io_exit(data, tdo, BENCH_BITS); break;
+#if XSVF_USE_SPI
+  case SPI:       jtag_spi_shift(data, NULL, BENCH_BITS, false); break;
+  case SPI_IO:    jtag_spi_shift(data, tdo, BENCH_BITS, false); break;
+#endif
+  default:        break;
+  }
+}
+
+static void table(TAP_SIM_ST *tap, uint32_t wait){
+  HOST_STATS_ST h0, h1;
+  uint64_t tck0;
+  int v;
+
+  tck_wait = wait;
+  printf("\ntck_wait %u, kernels %u Hz\n", wait, jtag_tck_hz(wait));
+  printf("%-22s %9s %11s %10s %9s %8s\n", "", "cyc/bit", "stores/bit", "loads/bit", "nops/bit", "TCK/bit");
+  for (v=0; v<VARIANTS; v++){
+    if (!XSVF_USE_SPI && (v == SPI || v == SPI_IO)) continue;
+    host_get_stats(&h0);
+    tck0 = tap->tck;
+    shift(v);
+    host_get_stats(&h1);
+    printf("%-22s %9.2f %11.2f %10.2f %9.2f %8.2f\n", names[v],
+        (double)(h1.cycles - h0.cycles) / BENCH_BITS,
+        (double)(h1.stores - h0.stores) / BENCH_BITS,
+        (double)(h1.loads - h0.loads) / BENCH_BITS,
+        (double)(h1.nops - h0.nops) / BENCH_BITS,
+        (double)(tap->tck - tck0) / BENCH_BITS);
+  }
+}
+
+int main(void){
+  static const TAP_MODEL_ST model = { .name = "bypass", .ir_len = 8, .ir_capture = 0x01 };
+  TAP_SIM_ST *tap = malloc(sizeof(TAP_SIM_ST));
+  uint32_t i;
+
+  for (i=0; i<sizeof(data); i++) data[i] = (uint8_t)(i * 37 + 11);
+  tap_init(tap, &model, STM32_SYSCLK);
+  host_attach(tap);
+  jtag_init();
+#if XSVF_USE_SPI
+  jtag_spi_init();
+  jtag_spi_rate(0, true);
+#endif
+  printf("shift cost per bit, %u bit scans\n", BENCH_BITS);
+  table(tap, 0);
+  table(tap, TCK_WAIT_DEFAULT);
+  printf("\ncyc/bit is the host cost model: %d cycles per BSRR store, %d per TDO load,\n"
+      "%d per NOP%s. Calls, branches, loops and table lookups in between\n"
+      "cost nothing in it, so it is a lower bound, furthest off for jtag_shift_ref\n"
+      "with its set_port() and pulse_clock() calls per bit. The stores, loads and\n"
+      "NOPs per bit are exact. The shell command \"bench\" measures the real cycles\n"
+      "with the DWT on the board.\n",
+      HOST_CYC_STORE, HOST_CYC_LOAD, HOST_CYC_NOP,
+      XSVF_USE_SPI ? ", the SCK period per SPI bit" : "");
+  host_attach(NULL);
+  tap_free(tap);
+  free(tap);
+  return 0;
+}
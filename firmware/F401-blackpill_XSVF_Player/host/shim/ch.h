@@ -0,0 +1,103 @@
+/*
+ * ch.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_SHIM_CH_H_
+#define HOST_SHIM_CH_H_
+
+/*
+ * The few ChibiOS/RT calls of the host buildable userlib modules. There is
+ * only one thread: a sleep advances the simulated clock, a semaphore or
+ * FIFO wait returns at once (see host_on_wait() for a stand-in producer).
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define TRUE  1
+#define FALSE 0
+
+typedef int32_t msg_t;
+typedef uint32_t sysinterval_t;
+typedef uint32_t systime_t;
+
+#define MSG_OK       ((msg_t)0)
+#define MSG_TIMEOUT  ((msg_t)-1)
+#define MSG_RESET    ((msg_t)-2)
+
+#define TIME_IMMEDIATE ((sysinterval_t)0)
+#define TIME_INFINITE  ((sysinterval_t)-1)
+
+/* as in cfg/chconf.h */
+#if !defined(CH_CFG_ST_FREQUENCY)
+#define CH_CFG_ST_FREQUENCY 10000
+#endif
+
+#define TIME_MS2I(ms)  ((sysinterval_t)((ms) * CH_CFG_ST_FREQUENCY / 1000))
+#define TIME_I2MS(i)   ((uint32_t)((uint64_t)(i) * 1000 / CH_CFG_ST_FREQUENCY))
+
+#define chDbgAssert(c, r) do { \
+  if (!(c)) { fprintf(stderr, "assert: %s\n", (r)); abort(); } \
+} while (0)
+
+typedef struct {
+  int32_t cnt;
+} binary_semaphore_t;
+
+void chBSemObjectInit(binary_semaphore_t *bsp, bool taken);
+void chBSemReset(binary_semaphore_t *bsp, bool taken);
+void chBSemSignal(binary_semaphore_t *bsp);
+msg_t chBSemWaitTimeout(binary_semaphore_t *bsp, sysinterval_t timeout);
+#define chBSemResetI chBSemReset
+#define chBSemWaitTimeoutS chBSemWaitTimeout
+static inline void chSchRescheduleS(void) {}
+
+/*
+ * Objects FIFO: a pool of free objects, linked through their first bytes
+ * like a ChibiOS memory pool, and a mailbox of sent objects, which holds
+ * object indexes since a pointer doesn't fit into msg_t here.
+ */
+typedef struct {
+  uint8_t *objs;
+  size_t objsize;
+  size_t objn;
+  void *free;
+  msg_t *msgbuf;
+  size_t rd;
+  size_t cnt;
+} objects_fifo_t;
+
+void chFifoObjectInit(objects_fifo_t *ofp, size_t objsize, size_t objn, void *objbuf, msg_t *msgbuf);
+void *chFifoTakeObjectTimeout(objects_fifo_t *ofp, sysinterval_t timeout);
+void chFifoReturnObject(objects_fifo_t *ofp, void *objp);
+void chFifoSendObject(objects_fifo_t *ofp, void *objp);
+msg_t chFifoReceiveObjectTimeout(objects_fifo_t *ofp, void **objpp, sysinterval_t timeout);
+
+static inline void chSysLock(void) {}
+static inline void chSysUnlock(void) {}
+
+void chThdSleep(sysinterval_t time);
+systime_t chVTGetSystemTime(void);
+
+#define chThdSleepMilliseconds(ms) chThdSleep(TIME_MS2I(ms))
+
+/* no threads: a thread is never started, its work is called directly */
+typedef uint32_t tprio_t;
+typedef struct thread thread_t;
+#define LOWPRIO    2
+#define NORMALPRIO 128
+#define THD_WORKING_AREA(s, n) uint8_t s[n]
+#define THD_FUNCTION(tname, arg) void tname(void *arg)
+static inline thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio, void (*pf)(void *), void *arg){
+  return NULL;
+}
+
+#define __DMB() __asm__ volatile("" ::: "memory")
+#define __NOP() host_nop()
+void host_nop(void);
+
+#endif /* HOST_SHIM_CH_H_ */
@@ -0,0 +1,30 @@
+/*
+ * chprintf.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_SHIM_CHPRINTF_H_
+#define HOST_SHIM_CHPRINTF_H_
+
+#include "ch.h"
+
+/* the sequential stream interface of ChibiOS, put and write only */
+typedef struct BaseSequentialStream BaseSequentialStream;
+
+struct BaseSequentialStreamVMT {
+  size_t (*write)(void *ip, const uint8_t *bp, size_t n);
+  msg_t (*put)(void *ip, uint8_t b);
+};
+
+struct BaseSequentialStream {
+  const struct BaseSequentialStreamVMT *vmt;
+};
+
+#define streamWrite(ip, bp, n)  ((ip)->vmt->write(ip, bp, n))
+#define streamPut(ip, b)        ((ip)->vmt->put(ip, b))
+
+int chprintf(BaseSequentialStream *chp, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+#endif /* HOST_SHIM_CHPRINTF_H_ */
@@ -0,0 +1,95 @@
+/*
+ * hal.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_SHIM_HAL_H_
+#define HOST_SHIM_HAL_H_
+
+/*
+ * The GPIO, PAL, SPI and DWT accesses of jtag.c and jtag_spi.c, routed
+ * into the TAP simulator by host_hal.c. Every access costs simulated CPU
+ * cycles, see host_hal.h.
+ */
+#include "ch.h"
+
+#define STM32_SYSCLK 84000000U
+#define STM32_PCLK2  84000000U
+#define STM32_TIMCLK2 84000000U
+
+/* PAL lines as port << 8 | pad, only GPIOA to GPIOC exist */
+#define GPIOA 0U
+#define GPIOB 1U
+#define GPIOC 2U
+#define PAL_LINE(port, pad)  (((port) << 8) | (pad))
+
+#define PAL_LOW   0U
+#define PAL_HIGH  1U
+
+#define PAL_MODE_INPUT_PULLDOWN    0x01U
+#define PAL_MODE_OUTPUT_PUSHPULL   0x02U
+#define PAL_STM32_OSPEED_HIGHEST   0x10U
+#define PAL_MODE_ALTERNATE(n)      (0x04U | ((n) << 8))
+
+typedef uint32_t ioline_t;
+typedef uint32_t iomode_t;
+
+void palSetLine(ioline_t line);
+void palClearLine(ioline_t line);
+uint32_t palReadLine(ioline_t line);
+void palSetLineMode(ioline_t line, iomode_t mode);
+
+/*
+ * SPI1 with SCK (PA5) wired to TCK and MOSI (PA7) to TDI, as in readme.txt.
+ * A transfer takes the bits at the SCK rate of cr1, mode 0, LSB first.
+ */
+#define SPI_CR1_BR_0      (1U << 3)
+#define SPI_CR1_BR_1      (1U << 4)
+#define SPI_CR1_BR_2      (1U << 5)
+#define SPI_CR1_LSBFIRST  (1U << 7)
+
+typedef struct {
+  uint32_t cr1;
+  uint32_t cr2;
+} SPIConfig;
+
+typedef struct {
+  const SPIConfig *config;
+} SPIDriver;
+
+extern SPIDriver SPID1;
+
+void spiStart(SPIDriver *spip, const SPIConfig *config);
+void spiStop(SPIDriver *spip);
+void spiExchange(SPIDriver *spip, size_t n, const void *txbuf, void *rxbuf);
+void spiSend(SPIDriver *spip, size_t n, const void *txbuf);
+
+/*
+ * BSRR stores take effect when the shim is entered the next time, so a
+ * plain assignment works: the store of the previous access is applied
+ * before the slot is handed out again. TDO comes from the simulator.
+ */
+#define XSVF_GPIO_BSRR (*host_bsrr())
+#define TDO_BB         (host_tdo())
+volatile uint32_t * host_bsrr(void);
+uint32_t host_tdo(void);
+
+/* the cycle counter runs on the simulated clock, CYCCNT can't be written */
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CYCCNT;
+} HOST_DWT_ST;
+
+typedef struct {
+  volatile uint32_t DEMCR;
+} HOST_COREDEBUG_ST;
+
+#define DWT        (host_dwt())
+#define CoreDebug  (&host_coredebug)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1U << 24)
+#define DWT_CTRL_CYCCNTENA_Msk      (1U << 0)
+HOST_DWT_ST * host_dwt(void);
+extern HOST_COREDEBUG_ST host_coredebug;
+
+#endif /* HOST_SHIM_HAL_H_ */
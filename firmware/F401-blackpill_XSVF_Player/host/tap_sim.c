@@ -0,0 +1,222 @@
+/*
+ * tap_sim.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "tap_sim.h"
+
+/* next state for TMS=0 and TMS=1, as in the state diagram of IEEE 1149.1 */
+static const uint8_t next_state[16][2] = {
+  { TAP_RTI,        TAP_TLR       },  /* Test-Logic-Reset */
+  { TAP_RTI,        TAP_SELECT_DR },  /* Run-Test/Idle */
+  { TAP_CAPTURE_DR, TAP_SELECT_IR },  /* Select-DR-Scan */
+  { TAP_SHIFT_DR,   TAP_EXIT1_DR  },  /* Capture-DR */
+  { TAP_SHIFT_DR,   TAP_EXIT1_DR  },  /* Shift-DR */
+  { TAP_PAUSE_DR,   TAP_UPDATE_DR },  /* Exit1-DR */
+  { TAP_PAUSE_DR,   TAP_EXIT2_DR  },  /* Pause-DR */
+  { TAP_SHIFT_DR,   TAP_UPDATE_DR },  /* Exit2-DR */
+  { TAP_RTI,        TAP_SELECT_DR },  /* Update-DR */
+  { TAP_CAPTURE_IR, TAP_TLR       },  /* Select-IR-Scan */
+  { TAP_SHIFT_IR,   TAP_EXIT1_IR  },  /* Capture-IR */
+  { TAP_SHIFT_IR,   TAP_EXIT1_IR  },  /* Shift-IR */
+  { TAP_PAUSE_IR,   TAP_UPDATE_IR },  /* Exit1-IR */
+  { TAP_PAUSE_IR,   TAP_EXIT2_IR  },  /* Pause-IR */
+  { TAP_SHIFT_IR,   TAP_UPDATE_IR },  /* Exit2-IR */
+  { TAP_RTI,        TAP_SELECT_DR },  /* Update-IR */
+};
+
+static const char * const state_names[16] = {
+  "TLR", "RTI", "SELECT_DR", "CAPTURE_DR", "SHIFT_DR", "EXIT1_DR", "PAUSE_DR", "EXIT2_DR",
+  "UPDATE_DR", "SELECT_IR", "CAPTURE_IR", "SHIFT_IR", "EXIT1_IR", "PAUSE_IR", "EXIT2_IR", "UPDATE_IR"
+};
+
+/* the registers every TAP has */
+static void bypass_capture(TAP_SIM_ST *t, uint8_t *bits){
+  bits[0] = 0;
+}
+
+static void idcode_capture(TAP_SIM_ST *t, uint8_t *bits){
+  tap_put(bits, 0, 32, t->model->idcode);
+}
+
+static const TAP_DR_ST bypass = { 0, 1, bypass_capture, NULL };
+static const TAP_DR_ST idcode = { 0, 32, idcode_capture, NULL };
+
+uint32_t tap_get(const uint8_t *bits, uint32_t first, uint32_t n){
+  uint32_t i, v = 0;
+
+  for (i=0; i<n; i++){
+    v |= (uint32_t)(bits[first + i] & 1) << i;
+  }
+  return v;
+}
+
+void tap_put(uint8_t *bits, uint32_t first, uint32_t n, uint32_t value){
+  uint32_t i;
+
+  for (i=0; i<n; i++){
+    bits[first + i] = (value >> i) & 1;
+  }
+}
+
+/* Microseconds since the cycle count since. */
+uint64_t tap_us(const TAP_SIM_ST *t, uint64_t since){
+  return (t->now - since) * 1000000 / t->hz;
+}
+
+const char * tap_state_name(uint8_t state){
+  return state_names[state & 0xf];
+}
+
+/* The register the current instruction selects. */
+static void select_dr(TAP_SIM_ST *t){
+  const TAP_MODEL_ST *m = t->model;
+  uint32_t i;
+
+  t->dr = &bypass;
+  if (m->idcode && (t->ir == m->idcode_ir)) {
+    t->dr = &idcode;
+    return;
+  }
+  for (i=0; i<m->ndrs; i++){
+    if (m->drs[i].ir == t->ir) {
+      t->dr = &m->drs[i];
+      return;
+    }
+  }
+}
+
+static void tap_reset(TAP_SIM_ST *t){
+  const TAP_MODEL_ST *m = t->model;
+
+  t->ir = m->idcode ? m->idcode_ir : (uint32_t)((1ULL << m->ir_len) - 1);
+  select_dr(t);
+  t->resets++;
+  if (m->reset) m->reset(t);
+}
+
+void tap_init(TAP_SIM_ST *t, const TAP_MODEL_ST *m, uint32_t hz){
+  memset(t, 0, sizeof(*t));
+  t->model = m;
+  t->hz = hz;
+  t->keep = calloc(m->ndrs ? m->ndrs : 1, sizeof(uint8_t *));
+  t->state = TAP_TLR;
+  if (m->init) m->init(t);
+  tap_reset(t);
+}
+
+void tap_free(TAP_SIM_ST *t){
+  uint32_t i;
+
+  if (t->model->release) t->model->release(t);
+  for (i=0; i<t->model->ndrs; i++){
+    free(t->keep[i]);
+  }
+  free(t->keep);
+  t->keep = NULL;
+}
+
+static void capture_ir(TAP_SIM_ST *t){
+  t->len = t->model->ir_len;
+  t->pos = 0;
+  tap_put(t->sh, 0, t->len, t->model->ir_capture);
+}
+
+static void capture_dr(TAP_SIM_ST *t){
+  const TAP_DR_ST *dr = t->dr;
+  uint8_t *keep;
+
+  t->len = dr->len;
+  t->pos = 0;
+  if (dr->capture) {
+    dr->capture(t, t->sh);
+    return;
+  }
+  keep = t->keep[dr - t->model->drs];
+  if (keep) memcpy(t->sh, keep, dr->len);
+  else memset(t->sh, 0, dr->len);
+}
+
+/* The shift register in order, bit 0 first. */
+static void unroll(TAP_SIM_ST *t, uint8_t *bits){
+  memcpy(bits, &t->sh[t->pos], t->len - t->pos);
+  memcpy(&bits[t->len - t->pos], t->sh, t->pos);
+}
+
+static void update_ir(TAP_SIM_ST *t){
+  uint8_t bits[TAP_IR_MAX];
+
+  unroll(t, bits);
+  t->ir = tap_get(bits, 0, t->len);
+  select_dr(t);
+  t->ir_scans++;
+}
+
+static void update_dr(TAP_SIM_ST *t){
+  static uint8_t bits[TAP_REG_MAX];
+  const TAP_DR_ST *dr = t->dr;
+  uint32_t k;
+
+  t->dr_scans++;
+  if ((dr == &bypass) || (dr == &idcode)) return;
+  unroll(t, bits);
+  k = dr - t->model->drs;
+  if (!dr->capture) {
+    if (!t->keep[k]) t->keep[k] = malloc(dr->len);
+    memcpy(t->keep[k], bits, dr->len);
+  }
+  if (dr->update) dr->update(t, bits);
+}
+
+/*
+ * Rising TCK edge. Capture-xR loads the register while leaving the state,
+ * Shift-xR moves it one bit towards TDO, Update-xR takes it over. The
+ * standard updates with the falling edge in Update-xR, nothing can tell
+ * the difference.
+ */
+void tap_rise(TAP_SIM_ST *t, bool tms, bool tdi){
+  uint8_t from = t->state, to = next_state[from][tms ? 1 : 0];
+
+  t->tck++;
+  switch (from) {
+  case TAP_CAPTURE_DR:
+    capture_dr(t);
+    break;
+  case TAP_CAPTURE_IR:
+    capture_ir(t);
+    break;
+  case TAP_SHIFT_DR:
+  case TAP_SHIFT_IR:
+    t->sh[t->pos] = tdi ? 1 : 0;
+    if (++t->pos == t->len) t->pos = 0;
+    break;
+  default:
+    break;
+  }
+  t->state = to;
+  if (to != from) {
+    switch (to) {
+    case TAP_TLR:
+      tap_reset(t);
+      break;
+    case TAP_UPDATE_IR:
+      update_ir(t);
+      break;
+    case TAP_UPDATE_DR:
+      update_dr(t);
+      break;
+    default:
+      break;
+    }
+    if (t->model->enter) t->model->enter(t, to);
+  }
+  /* TDO drives only while shifting, the pull-down holds it low otherwise */
+  t->tdo_next = ((to == TAP_SHIFT_DR) || (to == TAP_SHIFT_IR)) ? t->sh[t->pos] : 0;
+}
+
+void tap_fall(TAP_SIM_ST *t){
+  t->tdo = t->tdo_next;
+}
@@ -0,0 +1,101 @@
+/*
+ * tap_sim.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_TAP_SIM_H_
+#define HOST_TAP_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * IEEE 1149.1 TAP of one device, clocked pin by pin from the host shim.
+ * TMS and TDI are sampled with the rising TCK edge, TDO changes with the
+ * falling one. The states are numbered like STATE_* in xsvf.h, but the
+ * state machine is its own, so it checks the player instead of echoing it.
+ */
+#define TAP_TLR         0x00
+#define TAP_RTI         0x01
+#define TAP_SELECT_DR   0x02
+#define TAP_CAPTURE_DR  0x03
+#define TAP_SHIFT_DR    0x04
+#define TAP_EXIT1_DR    0x05
+#define TAP_PAUSE_DR    0x06
+#define TAP_EXIT2_DR    0x07
+#define TAP_UPDATE_DR   0x08
+#define TAP_SELECT_IR   0x09
+#define TAP_CAPTURE_IR  0x0a
+#define TAP_SHIFT_IR    0x0b
+#define TAP_EXIT1_IR    0x0c
+#define TAP_PAUSE_IR    0x0d
+#define TAP_EXIT2_IR    0x0e
+#define TAP_UPDATE_IR   0x0f
+
+#define TAP_REG_MAX     8192  // longest IR or DR in bits
+#define TAP_IR_MAX      32
+
+typedef struct TAP_SIM TAP_SIM_ST;
+
+/*
+ * A data register and the instruction which selects it. The shift
+ * register is handed over with one byte per bit, bit 0 is the one next
+ * to TDO. Without capture the register captures what was updated last.
+ */
+typedef struct {
+  uint32_t ir;
+  uint32_t len;
+  void (*capture)(TAP_SIM_ST *t, uint8_t *bits);
+  void (*update)(TAP_SIM_ST *t, const uint8_t *bits);
+} TAP_DR_ST;
+
+typedef struct {
+  const char *name;
+  uint32_t ir_len;
+  uint32_t ir_capture;    // Capture-IR value, the two LSBs are 01
+  uint32_t idcode;        // 0: no IDCODE register, Test-Logic-Reset selects BYPASS
+  uint32_t idcode_ir;
+  const TAP_DR_ST *drs;   // further registers, all other instructions select BYPASS
+  uint32_t ndrs;
+  /* optional hooks of a behavioural model */
+  void (*init)(TAP_SIM_ST *t);                  // sets up priv
+  void (*release)(TAP_SIM_ST *t);               // frees priv
+  void (*reset)(TAP_SIM_ST *t);                 // Test-Logic-Reset
+  void (*enter)(TAP_SIM_ST *t, uint8_t state);  // any state change
+  void (*print)(TAP_SIM_ST *t);                 // state of the target to stdout
+} TAP_MODEL_ST;
+
+struct TAP_SIM {
+  const TAP_MODEL_ST *model;
+  void *priv;             // state of the model
+  uint8_t state;
+  uint8_t tdo;            // TDO pin
+  uint8_t tdo_next;       // TDO after the next falling edge
+  uint32_t ir;
+  const TAP_DR_ST *dr;    // selected by ir
+  uint8_t **keep;         // last update of every model register
+  /* shift register: bit i is sh[(pos + i) % len] */
+  uint8_t sh[TAP_REG_MAX];
+  uint32_t len;
+  uint32_t pos;
+  /* time in CPU cycles, set by the caller before each edge */
+  uint64_t now;
+  uint32_t hz;
+  /* statistics */
+  uint64_t tck;
+  uint32_t ir_scans;
+  uint32_t dr_scans;
+  uint32_t resets;
+};
+
+void tap_init(TAP_SIM_ST *t, const TAP_MODEL_ST *m, uint32_t hz);
+void tap_free(TAP_SIM_ST *t);
+void tap_rise(TAP_SIM_ST *t, bool tms, bool tdi);
+void tap_fall(TAP_SIM_ST *t);
+uint32_t tap_get(const uint8_t *bits, uint32_t first, uint32_t n);
+void tap_put(uint8_t *bits, uint32_t first, uint32_t n, uint32_t value);
+uint64_t tap_us(const TAP_SIM_ST *t, uint64_t since);
+const char * tap_state_name(uint8_t state);
+
+#endif /* HOST_TAP_SIM_H_ */
@@ -0,0 +1,30 @@
+/*
+ * test.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#include <stdio.h>
+
+/*
+ * The host tests are plain programs: CHECK() reports a failed condition
+ * and goes on, TEST_END() prints the verdict and is the exit code.
+ */
+static int test_checks, test_failed;
+
+#define CHECK(c) do { \
+  test_checks++; \
+  if (!(c)) { \
+    test_failed++; \
+    if (test_failed <= 20) printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); \
+  } \
+} while (0)
+
+#define TEST_END(name) ( \
+  printf("%s: %d checks, %d failed\n", (name), test_checks, test_failed), \
+  test_failed ? 1 : 0)
+
+#endif /* HOST_TEST_H_ */
@@ -0,0 +1,119 @@
+/*
+ * test_frame.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "frame.h"
+#include "test.h"
+
+/*
+ * Ostrich v2 frames: frame_encode() output fed back into the receiver
+ * for every payload length up to a few COBS blocks, without zeros, with
+ * zeros at and next to the block edges and with random bytes.
+ */
+#define MAX_PAYLOAD 1100
+
+static uint8_t wire[FRAME_SIZE(MAX_PAYLOAD) + 8];
+static size_t wire_len, wire_pos;
+
+static size_t wire_read(uint8_t *buf, size_t n){
+  size_t k = wire_len - wire_pos;
+
+  if (k > n) k = n;
+  memcpy(buf, &wire[wire_pos], k);
+  wire_pos += k;
+  return k;
+}
+
+static void fill(uint8_t *p, uint16_t n, int pattern, uint32_t *seed){
+  uint16_t i;
+
+  for (i=0; i<n; i++){
+    switch (pattern){
+    case 0:   // no zero at all, the longest blocks
+      p[i] = (uint8_t)(i % 255 + 1);
+      break;
+    case 1:   // zeros where the body has a block edge (5 header bytes in front)
+      p[i] = (((i + FRAME_HEAD) % 254 == 253) || ((i + FRAME_HEAD) % 254 == 0)) ? 0 : 0x55;
+      break;
+    case 2:   // zeros only
+      p[i] = 0;
+      break;
+    default:
+      *seed = *seed * 1103515245 + 12345;
+      p[i] = (*seed >> 16) & 0xff;
+      if ((p[i] & 0x0f) == 0) p[i] = 0;
+      break;
+    }
+  }
+}
+
+/* sends and receives one frame like frame_receive() does, returns the status */
+static frame_status_t round_trip(const uint8_t *p, uint16_t n, uint8_t *got, uint16_t *got_len, uint16_t seq){
+  FRAME_RX_ST rx;
+  uint8_t head[FRAME_HEAD];
+
+  wire_len = frame_encode(wire, 'X', seq, p, n);
+  wire_pos = 0;
+  CHECK(wire_len <= (size_t)FRAME_SIZE(n));
+  CHECK(memchr(&wire[1], 0, wire_len - 2) == NULL);
+  CHECK((wire[0] == 0) && (wire[wire_len - 1] == 0));
+  frame_rx_start(&rx, wire_read);
+  if (frame_rx_get(&rx, head, FRAME_HEAD)){
+    CHECK(head[0] == 'X');
+    CHECK((((uint16_t)head[1] << 8) | head[2]) == seq);
+    *got_len = ((uint16_t)head[3] << 8) | head[4];
+    if (*got_len <= MAX_PAYLOAD) frame_rx_get(&rx, got, *got_len);
+  }
+  return frame_rx_finish(&rx);
+}
+
+int main(void){
+  static uint8_t p[MAX_PAYLOAD], got[MAX_PAYLOAD];
+  uint32_t seed = 1;
+  uint16_t n, got_len;
+  int pattern;
+  frame_status_t res;
+  FRAME_RX_ST rx;
+  uint8_t head[FRAME_HEAD];
+
+  for (pattern=0; pattern<4; pattern++){
+    for (n=0; n<=MAX_PAYLOAD; n++){
+      fill(p, n, pattern, &seed);
+      got_len = 0xffff;
+      memset(got, 0xaa, sizeof(got));
+      res = round_trip(p, n, got, &got_len, n);
+      CHECK(res == FRAME_OK);
+      CHECK(got_len == n);
+      CHECK(memcmp(p, got, n) == 0);
+      if (res != FRAME_OK) printf("  pattern %d, %d bytes: status %d\n", pattern, n, res);
+      /* the whole frame was taken, the next one starts at the delimiter */
+      CHECK(wire_pos == wire_len);
+    }
+  }
+
+  /* a flipped payload bit fails the CRC, the receiver stays in sync */
+  fill(p, 300, 3, &seed);
+  wire_len = frame_encode(wire, 'X', 7, p, 300);
+  wire[100] ^= (wire[100] == 0x01) ? 0x02 : 0x01;
+  wire_pos = 0;
+  frame_rx_start(&rx, wire_read);
+  frame_rx_get(&rx, head, FRAME_HEAD);
+  frame_rx_get(&rx, got, 300);
+  res = frame_rx_finish(&rx);
+  CHECK((res == FRAME_BAD_CRC) || (res == FRAME_LONG) || (res == FRAME_CUT));
+
+  /* a frame cut short by the next delimiter */
+  wire_len = frame_encode(wire, 'X', 8, p, 300);
+  wire[150] = 0;
+  wire_pos = 0;
+  frame_rx_start(&rx, wire_read);
+  frame_rx_get(&rx, head, FRAME_HEAD);
+  frame_rx_get(&rx, got, 300);
+  CHECK(frame_rx_finish(&rx) == FRAME_CUT);
+  CHECK(rx.sync == false);
+
+  return TEST_END("test_frame");
+}
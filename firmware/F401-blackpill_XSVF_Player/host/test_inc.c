@@ -0,0 +1,208 @@
+/*
+ * test_inc.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "xsvf.h"
+#include "chprintf.h"
+#include "host_hal.h"
+#include "tap_sim.h"
+#include "test.h"
+
+/*
+ * XSDRINC against tap_sim: the simulated register records every vector
+ * it takes over, the test counts the address bits up and fills the data
+ * bits on its own and compares. The masks have gaps, so the carry has to
+ * skip bits, and the files are played in fragments down to one byte.
+ */
+#define MAX_VECS 260
+
+static size_t null_write(void *ip, const uint8_t *bp, size_t n){
+  return n;
+}
+
+static msg_t null_put(void *ip, uint8_t b){
+  return MSG_OK;
+}
+
+static const struct BaseSequentialStreamVMT null_vmt = { null_write, null_put };
+static BaseSequentialStream null_stream = { &null_vmt };
+BaseSequentialStream *const ost = &null_stream;
+BaseSequentialStream *const dbg = &null_stream;
+
+/* what the register took over, LSB first */
+static uint8_t got[MAX_VECS][MAX_SIZE];
+static uint32_t ngot;
+
+static void record(TAP_SIM_ST *t, const uint8_t *bits){
+  uint32_t j;
+
+  if (ngot == MAX_VECS) return;
+  memset(got[ngot], 0, MAX_SIZE);
+  for (j=0; j<t->dr->len; j++) got[ngot][j >> 3] |= bits[j] << (j & 7);
+  ngot++;
+}
+
+static const TAP_DR_ST drs[] = {
+  { 0x02, 20, NULL, record },
+  { 0x03, 8 * MAX_SIZE, NULL, record },
+};
+static const TAP_MODEL_ST model = {
+  .name = "inc test", .ir_len = 8, .ir_capture = 0x01, .drs = drs, .ndrs = 2
+};
+
+static uint8_t file[4096];
+static uint32_t file_len;
+static uint32_t seed = 11;
+
+static uint8_t rnd(void){
+  seed = seed * 1103515245 + 12345;
+  return seed >> 16;
+}
+
+static void put(uint8_t b){
+  file[file_len++] = b;
+}
+
+static void put32(uint32_t v){
+  put(v >> 24);
+  put(v >> 16);
+  put(v >> 8);
+  put(v);
+}
+
+/* an operand of n bytes, LSB first in v, MSB first in the file */
+static void put_vec(const uint8_t *v, uint32_t n){
+  uint32_t k;
+
+  for (k=0; k<n; k++) put(v[n - 1 - k]);
+}
+
+static bool bit(const uint8_t *v, uint32_t j){
+  return (v[j >> 3] >> (j & 7)) & 1;
+}
+
+static void set_bit(uint8_t *v, uint32_t j, bool b){
+  if (b) v[j >> 3] |= 1 << (j & 7);
+  else v[j >> 3] &= ~(1 << (j & 7));
+}
+
+/* the address under amask as a number, at most 32 bits */
+static uint32_t address(const uint8_t *v, const uint8_t *amask, uint32_t bits){
+  uint32_t j, a = 0, w = 0;
+
+  for (j=0; j<bits; j++){
+    if (bit(amask, j)) a |= (uint32_t)bit(v, j) << w++;
+  }
+  return a;
+}
+
+/*
+ * A file with XSETSDRMASKS and an XSDRINC of times increments on the
+ * register of ir, then an XSDRTDO which checks the last vector. Returns
+ * false if the player or the vectors the register saw are wrong.
+ */
+static bool run(uint8_t ir, uint32_t bits, const uint8_t *amask, const uint8_t *dmask,
+    const uint8_t *start, uint32_t times, uint32_t frag){
+  static uint8_t data[MAX_VECS][MAX_SIZE];
+  uint8_t exp[MAX_SIZE], ones[MAX_SIZE], zero[MAX_SIZE] = { 0 };
+  uint32_t n = (bits + 7) / 8, dbits = 0, pos, len, j, d, k, a0, abits = 0;
+  uint16_t res = 1;
+  bool ok = true;
+
+  for (j=0; j<bits; j++){
+    if (bit(amask, j)) abits++;
+    else if (bit(dmask, j)) dbits++;
+  }
+  for (k=0; k<times; k++){
+    for (j=0; j<MAX_SIZE; j++) data[k][j] = rnd();
+  }
+  memset(ones, 0xff, sizeof(ones));
+  if (bits & 7) ones[n - 1] = (1 << (bits & 7)) - 1;
+
+  file_len = 0;
+  put(XREPEAT); put(0);
+  put(XRUNTEST); put32(0);
+  put(XSIR); put(8); put(ir);
+  put(XSDRSIZE); put32(bits);
+  put(XTDOMASK); put_vec(zero, n);
+  put(XSETSDRMASKS); put_vec(amask, n); put_vec(dmask, n);
+  put(XSDRINC); put_vec(start, n); put(times);
+  for (k=0; k<times; k++) put_vec(data[k], (dbits + 7) / 8);
+  /* the register captures the last vector */
+  memcpy(exp, start, n);
+  a0 = address(start, amask, bits);
+  for (k=1; k<=times; k++){
+    for (j=0, d=0; j<bits; j++){
+      if (bit(amask, j)) continue;
+      if (bit(dmask, j)) set_bit(exp, j, bit(data[k - 1], d++));
+    }
+  }
+  for (j=0, d=0; j<bits; j++){
+    if (bit(amask, j)) set_bit(exp, j, ((a0 + times) >> d++) & 1);
+  }
+  put(XTDOMASK); put_vec(ones, n);
+  put(XSDRTDO); put_vec(zero, n); put_vec(exp, n);
+  put(XCOMPLETE);
+
+  ngot = 0;
+  xsvf_player_reset();
+  for (pos=0; (pos < file_len) && (res == 1); pos += len){
+    len = frag ? 1 + rnd() % frag : file_len;
+    if (len > file_len - pos) len = file_len - pos;
+    res = write_xsvf(len, &file[pos], false);
+  }
+  if (res != 2) return false;
+  if (ngot != times + 2) return false;
+
+  /* every vector: the address counted up, the data of its increment */
+  for (k=0; k<=times; k++){
+    for (j=0, d=0; j<bits; j++){
+      if (bit(amask, j)) continue;
+      if (k && bit(dmask, j)) ok &= bit(got[k], j) == bit(data[k - 1], d++);
+      else ok &= bit(got[k], j) == bit(start, j);
+    }
+    if (abits < 32) ok &= address(got[k], amask, bits) == ((a0 + k) & ((1U << abits) - 1));
+  }
+  return ok;
+}
+
+int main(void){
+  /* 20 bits: address bits 0-2, 9 and 17, data bits 3, 5, 6, 12, 13 and 19 */
+  static const uint8_t amask[3] = { 0x07, 0x02, 0x02 };
+  static const uint8_t dmask[3] = { 0x68, 0x30, 0x08 };
+  /* the address starts at 3 of 31: bits 0, 1 set, the first increments carry */
+  static const uint8_t start[3] = { 0x03, 0x00, 0x04 };
+  uint8_t amask2[MAX_SIZE], dmask2[MAX_SIZE], start2[MAX_SIZE];
+  TAP_SIM_ST *tap = malloc(sizeof(TAP_SIM_ST));
+  uint32_t k, frag;
+
+  xsvf_init();
+  tap_init(tap, &model, STM32_SYSCLK);
+  host_attach(tap);
+
+  CHECK(address(start, amask, 20) == 3);
+  /* 40 increments wrap the 5 address bits */
+  for (frag=0; frag<=8; frag++){
+    CHECK(run(0x02, 20, amask, dmask, start, 40, frag));
+  }
+
+  /* MAX_SIZE bytes, an 11 bit address every 23 bits, data in every other bit */
+  memset(amask2, 0, sizeof(amask2));
+  for (k=0; k<11; k++) set_bit(amask2, 5 + 23 * k, true);
+  for (k=0; k<MAX_SIZE; k++){
+    dmask2[k] = 0x55 & ~amask2[k];
+    start2[k] = rnd();
+  }
+  for (k=0; k<4; k++){
+    CHECK(run(0x03, 8 * MAX_SIZE, amask2, dmask2, start2, 200, k ? 1 + 100 * (k - 1) : 0));
+  }
+
+  host_attach(NULL);
+  tap_free(tap);
+  free(tap);
+  return TEST_END("test_inc");
+}
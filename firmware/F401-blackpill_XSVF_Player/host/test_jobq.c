@@ -0,0 +1,147 @@
+/*
+ * test_jobq.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "jobq.h"
+#include "test.h"
+
+/*
+ * The chunk queue with the receiver and the worker taking turns: jobs
+ * come out in submission order, every one is finished with its own
+ * status and the buffers go round.
+ */
+#define CHUNKS 10
+#define SLICES 4
+
+static uint16_t sent;
+
+static XSVF_JOB_ST *submit(uint8_t fill, uint16_t size){
+  XSVF_JOB_ST *job = jobq_take(TIME_INFINITE);
+
+  CHECK(job != NULL);
+  if (job == NULL) return NULL;
+  CHECK(job->status == JOB_QUEUED);
+  CHECK((job->size == 0) && (job->framed == 0) && (job->tag == 0));
+  job->type = 'X';
+  job->size = size;
+  memset(job->buf, fill, size);
+  jobq_submit(job);
+  return job;
+}
+
+/*
+ * The receiver runs above the worker, so it comes in between the slices
+ * of a job, not only when the worker blocks. On the target it would wait
+ * for a buffer, here it comes back with the next slice.
+ */
+static void receiver(void){
+  XSVF_JOB_ST *job;
+
+  if (sent == CHUNKS) return;
+  job = jobq_take(TIME_IMMEDIATE);
+  if (job == NULL) return;
+  job->type = 'X';
+  job->size = 1 + sent;
+  memset(job->buf, sent, job->size);
+  jobq_submit(job);
+  sent++;
+}
+
+int main(void){
+  static const job_status_t result[] = {JOB_DONE, JOB_FAILED, JOB_DONE, JOB_DONE, JOB_FAILED, JOB_DONE};
+  XSVF_JOB_ST *a, *b, *job;
+  JOBQ_STATS_ST s;
+  uint16_t i, n;
+
+  /* all buffers taken: the next take times out, a discarded one comes back */
+  jobq_init();
+  a = jobq_take(TIME_IMMEDIATE);
+  b = jobq_take(TIME_IMMEDIATE);
+  CHECK((a != NULL) && (b != NULL) && (a != b));
+  CHECK(jobq_take(TIME_IMMEDIATE) == NULL);
+  jobq_discard(b);
+  CHECK(jobq_take(TIME_IMMEDIATE) == b);
+  jobq_discard(a);
+  jobq_discard(b);
+  CHECK(jobq_fetch(TIME_IMMEDIATE) == NULL);
+
+  /* ordered completion with the per-job status, XSVF_JOBS in flight */
+  for (i=0; i<sizeof(result)/sizeof(result[0]); i+=XSVF_JOBS){
+    for (n=0; n<XSVF_JOBS; n++) submit((uint8_t)(i + n), 100 + i + n);
+    CHECK(jobq_take(TIME_IMMEDIATE) == NULL);
+    for (n=0; n<XSVF_JOBS; n++){
+      job = jobq_fetch(TIME_IMMEDIATE);
+      CHECK(job != NULL);
+      if (job == NULL) break;
+      CHECK(job->seq == i + n);
+      CHECK(job->size == 100 + i + n);
+      CHECK((job->buf[0] == (uint8_t)(i + n)) && (job->buf[job->size - 1] == (uint8_t)(i + n)));
+      jobq_done(job, result[i + n]);
+      jobq_get_stats(&s);
+      CHECK(s.last_seq == i + n);
+      CHECK(s.last_status == result[i + n]);
+    }
+    CHECK(jobq_fetch(TIME_IMMEDIATE) == NULL);
+  }
+  jobq_get_stats(&s);
+  CHECK(s.submitted == 6);
+  CHECK(s.done == 4);
+  CHECK(s.failed == 2);
+  CHECK(s.skipped == 0);
+
+  /* buffer reuse: the finished buffers are the ones taken again */
+  a = jobq_take(TIME_IMMEDIATE);
+  b = jobq_take(TIME_IMMEDIATE);
+  CHECK((a != NULL) && (b != NULL) && (a != b));
+  CHECK(jobq_take(TIME_IMMEDIATE) == NULL);
+  jobq_discard(a);
+  jobq_discard(b);
+
+  /* a failed job flushes the ones queued behind it */
+  a = submit(0xa5, 10);
+  b = submit(0x5a, 20);
+  job = jobq_fetch(TIME_IMMEDIATE);
+  CHECK(job == a);
+  jobq_done(job, JOB_FAILED);
+  CHECK(jobq_flush() == 1);
+  jobq_get_stats(&s);
+  CHECK(s.skipped == 1);
+  CHECK(s.last_seq == 7);
+  CHECK(s.last_status == JOB_SKIPPED);
+  CHECK(jobq_fetch(TIME_IMMEDIATE) == NULL);
+  CHECK(jobq_take(TIME_IMMEDIATE) != NULL);
+  CHECK(jobq_take(TIME_IMMEDIATE) != NULL);
+  CHECK(jobq_take(TIME_IMMEDIATE) == NULL);
+
+  /*
+   * A worker which stays busy with every job: the next chunk comes in
+   * while it plays, so it never waits for one after the first.
+   */
+  jobq_init();
+  sent = 0;
+  receiver();
+  for (i=0; i<CHUNKS; i++){
+    job = jobq_fetch(TIME_IMMEDIATE);
+    CHECK(job != NULL);
+    if (job == NULL) break;
+    CHECK(job->seq == i);
+    CHECK((job->size == 1 + i) && (job->buf[i] == i));
+    for (n=0; n<SLICES; n++){
+      /* the worker plays on, the receiver preempts it */
+      receiver();
+      jobq_get_stats(&s);
+      CHECK(s.submitted == sent);
+      CHECK(s.done == i);
+    }
+    CHECK(sent == ((i + 2 < CHUNKS) ? i + 2 : CHUNKS));
+    jobq_done(job, JOB_DONE);
+  }
+  jobq_get_stats(&s);
+  CHECK(s.done == CHUNKS);
+  CHECK(jobq_fetch(TIME_IMMEDIATE) == NULL);
+
+  return TEST_END("test_jobq");
+}
@@ -0,0 +1,69 @@
+/*
+ * test_plan.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "jtag_plan.h"
+#include "test.h"
+
+/*
+ * The split of a scan between SPI and the GPIO kernels: SPI only ever gets
+ * whole bytes and never the exit bit, the kernels get the rest, and runs
+ * below min_bytes stay on the kernels.
+ */
+static void plan(uint32_t length, bool exit, uint32_t min_bytes, uint32_t spi_bytes, uint32_t gpio_bits){
+  JTAG_PLAN_ST p = {0xdead, 0xbeef};
+
+  jtag_plan(length, exit, min_bytes, &p);
+  CHECK(p.spi_bytes == spi_bytes);
+  CHECK(p.gpio_bits == gpio_bits);
+  if ((p.spi_bytes != spi_bytes) || (p.gpio_bits != gpio_bits))
+    printf("  %u bits, exit %d, min %u: %u bytes + %u bits\n",
+           (unsigned)length, exit, (unsigned)min_bytes, (unsigned)p.spi_bytes, (unsigned)p.gpio_bits);
+}
+
+int main(void){
+  uint32_t length, min;
+  int exit;
+
+  /* below a byte everything is GPIO, with and without exit */
+  for (length=0; length<8; length++){
+    plan(length, false, 1, 0, length);
+    plan(length, true, 1, 0, length);
+  }
+
+  /* a byte, and a byte and a bit */
+  plan(8, false, 1, 1, 0);
+  plan(8, true, 1, 0, 8);
+  plan(9, false, 1, 1, 1);
+  plan(9, true, 1, 1, 1);
+
+  /* multiples of 8: the exit bit keeps the last byte on the GPIO */
+  plan(64, false, 1, 8, 0);
+  plan(64, true, 1, 7, 8);
+  plan(67, true, 1, 8, 3);
+
+  /* min_bytes counts after the exit byte is taken off */
+  plan(32, false, 4, 4, 0);
+  plan(32, true, 4, 0, 32);
+  plan(40, true, 4, 4, 8);
+  plan(64, false, UINT32_MAX, 0, 64);
+
+  /* every length: whole bytes first, nothing lost, the exit bit on the GPIO */
+  for (min=0; min<6; min++){
+    for (length=0; length<300; length++){
+      for (exit=0; exit<2; exit++){
+        JTAG_PLAN_ST p;
+
+        jtag_plan(length, exit, min, &p);
+        CHECK(p.spi_bytes * 8 + p.gpio_bits == length);
+        CHECK((p.spi_bytes == 0) || (p.spi_bytes >= min));
+        if (exit && length) CHECK(p.gpio_bits > 0);
+        CHECK((p.gpio_bits < 16) || (p.spi_bytes == 0));
+      }
+    }
+  }
+
+  return TEST_END("test_plan");
+}
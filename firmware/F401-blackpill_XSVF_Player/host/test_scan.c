@@ -0,0 +1,199 @@
+/*
+ * test_scan.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "xsvf.h"
+#include "ring.h"
+#include "jobq.h"
+#include "chprintf.h"
+#include "host_hal.h"
+#include "tap_sim.h"
+#include "test.h"
+
+/*
+ * Scans far longer than the 32 byte blocks of scan(), with an irregular
+ * TDO mask, played through write_xsvf() in fragments of any size down to
+ * one byte and through stream_xsvf() out of a ring shorter than one
+ * instruction. The data register captures what was shifted in last, so
+ * every XSDRTDO checks the one before.
+ */
+#define DR_IR    0x02
+#define DR_BITS  8000               // not a multiple of 32 bytes
+#define DR_BYTES ((DR_BITS + 7) / 8)
+
+static size_t null_write(void *ip, const uint8_t *bp, size_t n){
+  return n;
+}
+
+static msg_t null_put(void *ip, uint8_t b){
+  return MSG_OK;
+}
+
+static const struct BaseSequentialStreamVMT null_vmt = { null_write, null_put };
+static BaseSequentialStream null_stream = { &null_vmt };
+BaseSequentialStream *const ost = &null_stream;
+BaseSequentialStream *const dbg = &null_stream;
+
+static const TAP_DR_ST dr = { DR_IR, DR_BITS, NULL, NULL };
+static const TAP_MODEL_ST model = {
+  .name = "scan test", .ir_len = 8, .ir_capture = 0x01, .drs = &dr, .ndrs = 1
+};
+
+static uint8_t file[16 * DR_BYTES];
+static uint32_t file_len;
+static uint32_t seed = 7;
+
+static uint8_t rnd(void){
+  seed = seed * 1103515245 + 12345;
+  return seed >> 16;
+}
+
+static void put(uint8_t b){
+  file[file_len++] = b;
+}
+
+static void put32(uint32_t v){
+  put(v >> 24);
+  put(v >> 16);
+  put(v >> 8);
+  put(v);
+}
+
+/* an operand, LSB first in v, MSB first in the file */
+static void put_vec(const uint8_t *v){
+  uint32_t k;
+
+  for (k=0; k<DR_BYTES; k++) put(v[DR_BYTES - 1 - k]);
+}
+
+/*
+ * XSDRTDO of tdi, expecting prev under mask. The bits outside the mask
+ * get noise, bad flips one bit under it.
+ */
+static void put_sdrtdo(const uint8_t *tdi, const uint8_t *prev, const uint8_t *mask, bool bad){
+  uint8_t exp[DR_BYTES];
+  uint32_t k;
+
+  for (k=0; k<DR_BYTES; k++) exp[k] = (prev[k] & mask[k]) | (rnd() & ~mask[k]);
+  if (bad) {
+    for (k=DR_BYTES - 1; mask[k] == 0; k--) ;
+    exp[k] ^= mask[k] & -mask[k];
+  }
+  put(XSDRTDO);
+  put_vec(tdi);
+  put_vec(exp);
+}
+
+static void make_file(bool bad){
+  static uint8_t a[DR_BYTES], b[DR_BYTES], c[DR_BYTES], mask[DR_BYTES], none[DR_BYTES];
+  uint32_t k;
+
+  for (k=0; k<DR_BYTES; k++){
+    a[k] = rnd();
+    b[k] = rnd();
+    c[k] = rnd();
+    mask[k] = rnd() & rnd();
+  }
+  file_len = 0;
+  put(XREPEAT); put(0);
+  put(XRUNTEST); put32(0);
+  put(XSIR); put(8); put(DR_IR);
+  put(XSDRSIZE); put32(DR_BITS);
+  /* XSDR checks against the mask of the previous run */
+  put(XTDOMASK); put_vec(none);
+  put(XSDR); put_vec(a);
+  put(XTDOMASK); put_vec(mask);
+  put_sdrtdo(b, a, mask, false);
+  put_sdrtdo(c, b, mask, false);
+  put_sdrtdo(a, c, mask, bad);
+  put(XCOMPLETE);
+}
+
+/* fragments of 1..max bytes, 0 plays the file in one piece */
+static uint16_t play(uint32_t max){
+  uint32_t pos = 0, n;
+  uint16_t res = 1;
+
+  xsvf_player_reset();
+  while ((pos < file_len) && (res == 1)){
+    n = max ? 1 + rnd() % max : file_len;
+    if (n > file_len - pos) n = file_len - pos;
+    res = write_xsvf(n, &file[pos], false);
+    pos += n;
+  }
+  return res;
+}
+
+/* the receiver side of the stream: a few bytes whenever the player waits */
+static RING_ST ring;
+static uint8_t ring_buf[256];
+static uint32_t stream_pos, stream_max;
+
+static void receive(void){
+  uint32_t n = 1 + rnd() % stream_max;
+
+  if (n > file_len - stream_pos) n = file_len - stream_pos;
+  stream_pos += ring_write(&ring, &file[stream_pos], n);
+}
+
+static uint16_t stream(uint32_t max, uint32_t spill_size){
+  static uint8_t spill[XSVF_JOB_SIZE];
+
+  ring_init(&ring, ring_buf, sizeof(ring_buf));
+  stream_pos = 0;
+  stream_max = max;
+  host_on_wait(receive);
+  xsvf_player_reset();
+  return stream_xsvf(&ring, spill, spill_size, TIME_MS2I(100));
+}
+
+int main(void){
+  static const uint32_t sizes[] = { 0, 1, 2, 3, 7, 31, 64, 65, 100, 333, 1000, 2500 };
+  TAP_SIM_ST *tap = malloc(sizeof(TAP_SIM_ST));
+  uint32_t i, k;
+  int bad;
+
+  xsvf_init();
+  tap_init(tap, &model, STM32_SYSCLK);
+  host_attach(tap);
+
+  for (bad=0; bad<2; bad++){
+    make_file(bad);
+    for (i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++){
+      for (k=0; k<3; k++){
+        CHECK(play(sizes[i]) == (bad ? 0 : 2));
+      }
+    }
+    for (i=1; i<sizeof(sizes)/sizeof(sizes[0]); i++){
+      CHECK(stream(sizes[i], XSVF_JOB_SIZE) == (bad ? 0 : 1));
+    }
+  }
+
+  /* an instruction longer than both the ring and spill */
+  make_file(false);
+  CHECK(stream(100, 2 * DR_BYTES) == 0);
+
+  /* an XSDRSIZE which would wrap the operand sizes is refused, before its scan */
+  for (k=0; k<2; k++){
+    file_len = 0;
+    put(XSDRSIZE); put32(k ? 0xFFFFFFF9 : XSVF_SDR_MAX + 1);
+    put(XSDR); put(0x55);
+    put(XCOMPLETE);
+    CHECK(play(0) == 0);
+    CHECK(play(1) == 0);
+  }
+  file_len = 0;
+  put(XSDRSIZE); put32(XSVF_SDR_MAX);
+  put(XCOMPLETE);
+  CHECK(play(0) == 2);
+
+  host_on_wait(NULL);
+  host_attach(NULL);
+  tap_free(tap);
+  free(tap);
+  return TEST_END("test_scan");
+}
@@ -0,0 +1,136 @@
+/*
+ * test_tune.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "tck_tune.h"
+#include "test.h"
+
+/*
+ * tune_sweep() against a fake chain: devices in BYPASS delay the pattern
+ * by one bit each, and above a rate threshold TDO goes wrong in one of a
+ * few ways. The rates come in steps, like the TCK dividers do.
+ */
+#define FAKE_ID    0x0A0C40DDU
+#define FAKE_STEP  1000U
+
+enum { BAD_BIT, BAD_DELAY, BAD_IDCODE };
+
+static struct {
+  uint32_t devices;       // in BYPASS, the pattern comes out that many bits late
+  uint32_t threshold;     // highest rate that still works
+  int fault;              // what goes wrong above it
+  uint32_t idcode;
+  uint32_t hz;            // set now
+} fake;
+
+static uint32_t fake_set_rate(uint32_t hz){
+  fake.hz = hz / FAKE_STEP * FAKE_STEP;
+  return fake.hz;
+}
+
+static bool fake_probe(const uint8_t *pattern, uint8_t *tdo, uint32_t *idcode){
+  uint32_t i, j, delay = fake.devices;
+  bool bad = fake.hz > fake.threshold;
+
+  if (bad && (fake.fault == BAD_DELAY)) delay++;
+  memset(tdo, 0, TUNE_BITS / 8);
+  for (i=delay; i<TUNE_BITS; i++){
+    j = i - delay;
+    tdo[i >> 3] |= ((pattern[j >> 3] >> (j & 7)) & 1) << (i & 7);
+  }
+  if (bad && (fake.fault == BAD_BIT)) tdo[TUNE_BITS / 16] ^= 0x10;
+  *idcode = (bad && (fake.fault == BAD_IDCODE)) ? (fake.idcode ^ 0x100) : fake.idcode;
+  return true;
+}
+
+static const TUNE_OPS_ST ops = { fake_set_rate, fake_probe };
+
+/* the last rate of the 25% steps from min_hz which is not above the threshold */
+static uint32_t expect(uint32_t min_hz, uint32_t max_hz, uint32_t threshold, uint32_t margin){
+  uint32_t req = min_hz, good = min_hz / FAKE_STEP * FAKE_STEP, hz;
+
+  while (req < max_hz){
+    req += req / 4;
+    if (req > max_hz) req = max_hz;
+    hz = req / FAKE_STEP * FAKE_STEP;
+    if (hz > threshold) break;
+    good = hz;
+  }
+  good -= good / 100 * margin;
+  return good / FAKE_STEP * FAKE_STEP;
+}
+
+static uint32_t sweep(uint32_t devices, uint32_t threshold, int fault, uint32_t margin, uint32_t *idcode){
+  memset(&fake, 0, sizeof(fake));
+  fake.devices = devices;
+  fake.threshold = threshold;
+  fake.fault = fault;
+  fake.idcode = FAKE_ID;
+  return tune_sweep(&ops, 100000, 20000000, margin, idcode);
+}
+
+int main(void){
+  uint32_t devices, hz, id, i;
+  int fault;
+
+  /* every fault mode and chain length: the highest good rate less the margin */
+  for (fault=BAD_BIT; fault<=BAD_IDCODE; fault++){
+    for (devices=1; devices<=TUNE_MAX_DELAY - 1; devices++){
+      hz = sweep(devices, 1000000, fault, 10, &id);
+      CHECK(hz == expect(100000, 20000000, 1000000, 10));
+      CHECK(id == FAKE_ID);
+      CHECK(fake.hz == hz);
+    }
+  }
+  hz = sweep(3, 1000000, BAD_BIT, 0, &id);
+  CHECK(hz == expect(100000, 20000000, 1000000, 0));
+  CHECK(hz <= 1000000);
+  CHECK(hz > 1000000 * 4 / 5);
+
+  /* nothing goes wrong: max_hz less the margin */
+  hz = sweep(2, UINT32_MAX, BAD_BIT, 5, &id);
+  CHECK(hz == 20000000 - 20000000 / 100 * 5);
+
+  /* failing at min_hz: 0, and no IDCODE */
+  id = 1234;
+  hz = sweep(1, 50000, BAD_BIT, 10, &id);
+  CHECK(hz == 0);
+  CHECK(id == 0);
+  hz = sweep(4, 50000, BAD_BIT, 10, &id);
+  CHECK(hz == 0);
+
+  /* more devices than a BYPASS delay can tell: no loopback at all */
+  hz = sweep(TUNE_MAX_DELAY + 1, UINT32_MAX, BAD_BIT, 10, &id);
+  CHECK(hz == 0);
+
+  /* stuck TDO, all ones or all zeros */
+  memset(&fake, 0, sizeof(fake));
+  fake.idcode = 0xFFFFFFFF;
+  fake.threshold = UINT32_MAX;
+  CHECK(tune_sweep(&ops, 100000, 20000000, 10, &id) == 0);
+  fake.idcode = 0;
+  CHECK(tune_sweep(&ops, 100000, 20000000, 10, &id) == 0);
+  CHECK(tune_idcode_valid(FAKE_ID));
+  CHECK(!tune_idcode_valid(0xFFFFFFFF));
+  CHECK(!tune_idcode_valid(0x12345678));
+
+  /* the cache: replaced in turn when full, an update keeps its slot */
+  CHECK(tune_cache_get(FAKE_ID) == 0);
+  for (i=0; i<TUNE_CACHE; i++) tune_cache_put(0x1001 + 2 * i, 1000000 + i);
+  for (i=0; i<TUNE_CACHE; i++) CHECK(tune_cache_get(0x1001 + 2 * i) == 1000000 + i);
+  tune_cache_put(0x1001, 500000);
+  CHECK(tune_cache_get(0x1001) == 500000);
+  tune_cache_put(FAKE_ID, 42000);
+  CHECK(tune_cache_get(FAKE_ID) == 42000);
+  CHECK(tune_cache_get(0x1001) == 0);
+  for (i=1; i<TUNE_CACHE; i++) CHECK(tune_cache_get(0x1001 + 2 * i) == 1000000 + i);
+  tune_cache_put(0x2001, 1);
+  CHECK(tune_cache_get(0x1003) == 0);
+  CHECK(tune_cache_get(FAKE_ID) == 42000);
+  CHECK(tune_cache_get(0x2001) == 1);
+
+  return TEST_END("test_tune");
+}
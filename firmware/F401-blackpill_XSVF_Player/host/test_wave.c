@@ -0,0 +1,131 @@
+/*
+ * test_wave.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+#include "jtag.h"
+#include "jtag_wave.h"
+#include "host_hal.h"
+#include "tap_sim.h"
+#include "test.h"
+
+/*
+ * The timer/DMA waveform against the bit-bang reference: wave_compile()
+ * words are stored into the BSRR one by one and the TDO port is sampled
+ * after each, like the DMA streams do. Both drive the same simulated TAP
+ * through a data register which captures a pattern, TDO and the updated
+ * register have to come out the same.
+ */
+#define DR_IR   0x02
+#define DR_LEN  600
+
+static uint8_t updated[DR_LEN];
+
+static void dr_capture(TAP_SIM_ST *t, uint8_t *bits){
+  uint32_t i;
+
+  for (i=0; i<DR_LEN; i++) bits[i] = (i * 7 + i / 5) & 1;
+}
+
+static void dr_update(TAP_SIM_ST *t, const uint8_t *bits){
+  memcpy(updated, bits, DR_LEN);
+}
+
+static const TAP_DR_ST dr = { DR_IR, DR_LEN, dr_capture, dr_update };
+static const TAP_MODEL_ST model = {
+  .name = "wave test", .ir_len = 8, .ir_capture = 0x01, .drs = &dr, .ndrs = 1
+};
+
+static uint32_t words[WAVE_WORDS(DR_LEN)];
+static uint16_t samples[WAVE_WORDS(DR_LEN)];
+
+/* TAP navigation like the player's, through the TMS/TDI latches of jtag.c */
+static void step(bool tms){
+  set_port(TMS, tms);
+  pulse_clock();
+}
+
+static void steps(uint32_t tms, uint32_t n){
+  while (n--){
+    step(tms & 1);
+    tms >>= 1;
+  }
+}
+
+/* what jtag_dma_shift() does with a run, without the timer */
+static void wave_shift(const uint8_t *data, uint8_t *tdo, uint32_t length, bool exit){
+  uint32_t i, n = wave_compile(words, data, length, exit);
+
+  for (i=0; i<n; i++){
+    XSVF_GPIO_BSRR = words[i];
+    samples[i] = (uint16_t)(host_tdo() << TDO_Pin);
+  }
+  wave_tdo(samples, tdo, length);
+  jtag_latch(words[n-1]);
+}
+
+/*
+ * One DR scan from Run-Test/Idle to Run-Test/Idle, TDO into tdo, the
+ * register as updated into reg. Without exit the scan leaves Shift-DR
+ * with an extra TMS=1 step, whose TDI is 0.
+ */
+static uint8_t dr_scan(bool wave, const uint8_t *data, uint8_t *tdo, uint32_t length, bool exit, uint8_t *reg){
+  TAP_SIM_ST tap;
+  uint8_t ir = DR_IR, state;
+
+  tap_init(&tap, &model, STM32_SYSCLK);
+  host_attach(&tap);
+  steps(0x1f, 6);             // Test-Logic-Reset, Run-Test/Idle
+  steps(0x03, 4);             // Shift-IR
+  jtag_shift_ref(&ir, NULL, 8, 1);
+  steps(0x01, 2);             // Update-IR, Run-Test/Idle
+  steps(0x01, 3);             // Shift-DR
+  memset(tdo, 0, (DR_LEN + 7) / 8);
+  if (wave) wave_shift(data, tdo, length, exit);
+  else jtag_shift_ref(data, tdo, length, exit);
+  if (!exit) {
+    set_port(TDI, 0);
+    step(1);
+  }
+  CHECK(tap.state == TAP_EXIT1_DR);
+  steps(0x01, 2);             // Update-DR, Run-Test/Idle
+  set_port(TCK, 0);
+  host_flush();
+  state = tap.state;
+  memcpy(reg, updated, DR_LEN);
+  host_attach(NULL);
+  tap_free(&tap);
+  return state;
+}
+
+int main(void){
+  static uint8_t data[DR_LEN / 8], tdo_ref[DR_LEN / 8], tdo_wave[DR_LEN / 8];
+  static uint8_t reg_ref[DR_LEN], reg_wave[DR_LEN];
+  static const uint32_t lengths[] = { 1, 2, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 255, 256, 257, DR_LEN - 1 };
+  uint32_t seed = 5, i, k, length;
+  int exit;
+
+  jtag_init();
+  for (k=0; k<sizeof(lengths)/sizeof(lengths[0]); k++){
+    length = lengths[k];
+    for (exit=0; exit<2; exit++){
+      for (i=0; i<sizeof(data); i++){
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+      }
+      CHECK(dr_scan(false, data, tdo_ref, length, exit, reg_ref) == TAP_RTI);
+      CHECK(dr_scan(true, data, tdo_wave, length, exit, reg_wave) == TAP_RTI);
+      CHECK(memcmp(tdo_ref, tdo_wave, (length + 7) / 8) == 0);
+      CHECK(memcmp(reg_ref, reg_wave, DR_LEN) == 0);
+      /* the captured pattern came out first */
+      CHECK((tdo_wave[0] & 1) == 0);
+      if (length > 1) CHECK(((tdo_wave[0] >> 1) & 1) == 1);
+    }
+  }
+
+  return TEST_END("test_wave");
+}
@@ -0,0 +1,98 @@
+/*
+ * trace.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "trace.h"
+
+bool trace_open(TRACE_ST *t, const char *path){
+  memset(t, 0, sizeof(*t));
+  t->f = fopen(path, "wb");
+  if (!t->f) return false;
+  fwrite(TRACE_MAGIC, 1, 8, t->f);
+  t->bytes = 8;
+  return true;
+}
+
+static void put_record(TRACE_ST *t){
+  uint64_t n = t->run;
+
+  if (!n) {
+    fputc(t->last, t->f);
+    t->bytes++;
+    return;
+  }
+  fputc(t->last | TRACE_RUN, t->f);
+  t->bytes++;
+  do {
+    fputc((n & 0x7f) | ((n > 0x7f) ? 0x80 : 0), t->f);
+    t->bytes++;
+    n >>= 7;
+  } while (n);
+}
+
+void trace_edge(TRACE_ST *t, bool tms, bool tdi, bool tdo, uint8_t state){
+  uint8_t rec = (tms ? TRACE_TMS : 0) | (tdi ? TRACE_TDI : 0) | (tdo ? TRACE_TDO : 0) |
+      ((state & 0xf) << 3);
+
+  t->edges++;
+  if (t->open && (rec == t->last)) {
+    t->run++;
+    return;
+  }
+  if (t->open) put_record(t);
+  t->last = rec;
+  t->run = 0;
+  t->open = true;
+}
+
+void trace_close(TRACE_ST *t){
+  if (!t->f) return;
+  if (t->open) put_record(t);
+  fclose(t->f);
+  t->f = NULL;
+}
+
+bool trace_read_open(TRACE_RD_ST *r, const char *path){
+  char magic[8];
+
+  memset(r, 0, sizeof(*r));
+  r->f = fopen(path, "rb");
+  if (!r->f) return false;
+  if ((fread(magic, 1, 8, r->f) != 8) || memcmp(magic, TRACE_MAGIC, 8)) {
+    fclose(r->f);
+    r->f = NULL;
+    return false;
+  }
+  return true;
+}
+
+/* The next edge, false at the end of the trace. */
+bool trace_read(TRACE_RD_ST *r, uint8_t *rec){
+  int c, shift = 0;
+  uint64_t n = 0;
+
+  if (!r->left) {
+    if ((c = fgetc(r->f)) == EOF) return false;
+    r->rec = c & ~TRACE_RUN;
+    if (c & TRACE_RUN) {
+      do {
+        if ((c = fgetc(r->f)) == EOF) return false;
+        n |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+      } while (c & 0x80);
+    }
+    r->left = n + 1;
+  }
+  r->left--;
+  r->edges++;
+  *rec = r->rec;
+  return true;
+}
+
+void trace_read_close(TRACE_RD_ST *r){
+  if (r->f) fclose(r->f);
+  r->f = NULL;
+}
@@ -0,0 +1,57 @@
+/*
+ * trace.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_TRACE_H_
+#define HOST_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Pin-level trace of the JTAG port: one record per rising TCK edge, with
+ * TMS and TDI as the TAP samples them, TDO as the player could read it
+ * just before the edge and the TAP state the edge leaves. The falling
+ * edge only moves TDO, which the next record carries.
+ *
+ * File: TRACE_MAGIC, then records of one byte
+ *   bit 0 TMS, bit 1 TDI, bit 2 TDO, bits 3..6 TAP state,
+ *   bit 7 set: a count of further identical edges follows, 7 bits a byte,
+ *   LSB first, bit 7 set while more bytes follow.
+ * So the long waits in Run-Test/Idle take a few bytes.
+ */
+#define TRACE_MAGIC  "JTRC0001"
+
+#define TRACE_TMS    0x01
+#define TRACE_TDI    0x02
+#define TRACE_TDO    0x04
+#define TRACE_STATE(b)  (((b) >> 3) & 0xf)
+#define TRACE_RUN    0x80
+
+typedef struct {
+  FILE *f;
+  uint8_t last;       // record of the current run
+  uint64_t run;       // further edges in the run
+  bool open;          // a record is pending
+  uint64_t edges;
+  uint64_t bytes;
+} TRACE_ST;
+
+typedef struct {
+  FILE *f;
+  uint8_t rec;
+  uint64_t left;      // edges left of the current record
+  uint64_t edges;     // read so far
+} TRACE_RD_ST;
+
+bool trace_open(TRACE_ST *t, const char *path);
+void trace_edge(TRACE_ST *t, bool tms, bool tdi, bool tdo, uint8_t state);
+void trace_close(TRACE_ST *t);
+bool trace_read_open(TRACE_RD_ST *r, const char *path);
+bool trace_read(TRACE_RD_ST *r, uint8_t *rec);
+void trace_read_close(TRACE_RD_ST *r);
+
+#endif /* HOST_TRACE_H_ */
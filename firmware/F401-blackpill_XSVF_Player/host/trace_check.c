@@ -0,0 +1,125 @@
+/*
+ * trace_check.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tap_sim.h"
+#include "trace.h"
+
+/*
+ * Compares the pin traces of two JTAG engines playing the same file.
+ * They are equivalent if they walk the TAP through the same states with
+ * the same TMS, and shift the same TDI and see the same TDO in Shift-xR.
+ * Clocks which keep the TAP in Test-Logic-Reset, Run-Test/Idle or a Pause
+ * state are idle: a faster engine clocks more of them while it waits the
+ * same time, so they are only counted.
+ * The edges before the first one in Test-Logic-Reset depend on where the
+ * previous file left the TAP, they are skipped. A trace which never resets
+ * the TAP is compared from its start.
+ */
+typedef struct {
+  const char *name;
+  TRACE_RD_ST rd;
+  uint64_t idle;
+  uint64_t skip;      // edges before the first reset
+} SIDE_ST;
+
+static bool idle_edge(uint8_t rec){
+  bool tms = rec & TRACE_TMS;
+
+  switch (TRACE_STATE(rec)) {
+  case TAP_TLR:
+    return tms;
+  case TAP_RTI:
+  case TAP_PAUSE_DR:
+  case TAP_PAUSE_IR:
+    return !tms;
+  default:
+    return false;
+  }
+}
+
+/* the bits which count in the state of the edge */
+static uint8_t edge_mask(uint8_t rec){
+  uint8_t state = TRACE_STATE(rec);
+
+  if ((state == TAP_SHIFT_DR) || (state == TAP_SHIFT_IR)) return 0x7f;
+  return 0x7f & ~(TRACE_TDI | TRACE_TDO);
+}
+
+static bool next_edge(SIDE_ST *s, uint8_t *rec){
+  while (trace_read(&s->rd, rec)){
+    if (s->rd.edges <= s->skip) continue;
+    if (!idle_edge(*rec)) return true;
+    s->idle++;
+  }
+  return false;
+}
+
+static bool open_side(SIDE_ST *s){
+  uint8_t rec;
+
+  if (!trace_read_open(&s->rd, s->name)) return false;
+  while (trace_read(&s->rd, &rec)){
+    if (TRACE_STATE(rec) == TAP_TLR) {
+      s->skip = s->rd.edges - 1;
+      break;
+    }
+  }
+  trace_read_close(&s->rd);
+  return trace_read_open(&s->rd, s->name);
+}
+
+static void print_edge(const SIDE_ST *s, uint8_t rec){
+  printf("  %s: edge %llu, %s, TMS %d TDI %d TDO %d\n", s->name,
+      (unsigned long long)s->rd.edges - 1, tap_state_name(TRACE_STATE(rec)),
+      (rec & TRACE_TMS) ? 1 : 0, (rec & TRACE_TDI) ? 1 : 0, (rec & TRACE_TDO) ? 1 : 0);
+}
+
+int main(int argc, char **argv){
+  SIDE_ST a = { 0 }, b = { 0 };
+  uint8_t ra, rb;
+  bool more_a, more_b;
+  uint64_t compared = 0;
+  int64_t diff;
+
+  if (argc != 3) {
+    fprintf(stderr, "usage: trace_check reference.trc candidate.trc\n");
+    return 2;
+  }
+  a.name = argv[1];
+  b.name = argv[2];
+  if (!open_side(&a) || !open_side(&b)) {
+    fprintf(stderr, "can't read %s\n", a.rd.f ? b.name : a.name);
+    return 2;
+  }
+
+  while (1){
+    more_a = next_edge(&a, &ra);
+    more_b = next_edge(&b, &rb);
+    if (!more_a || !more_b) break;
+    if ((ra ^ rb) & edge_mask(ra)) {
+      printf("DIFFERENT after %llu compared edges\n", (unsigned long long)compared);
+      print_edge(&a, ra);
+      print_edge(&b, rb);
+      return 1;
+    }
+    compared++;
+  }
+  if (more_a != more_b) {
+    printf("DIFFERENT: %s ends first after %llu compared edges\n",
+        more_a ? b.name : a.name, (unsigned long long)compared);
+    return 1;
+  }
+  diff = (int64_t)b.rd.edges - (int64_t)a.rd.edges;
+  printf("equivalent: %llu edges compared, TCK %llu / %llu (%+lld, %+.2f%%), idle %llu / %llu\n",
+      (unsigned long long)compared, (unsigned long long)a.rd.edges, (unsigned long long)b.rd.edges,
+      (long long)diff, a.rd.edges ? 100.0 * diff / a.rd.edges : 0.0,
+      (unsigned long long)a.idle, (unsigned long long)b.idle);
+  trace_read_close(&a.rd);
+  trace_read_close(&b.rd);
+  return 0;
+}
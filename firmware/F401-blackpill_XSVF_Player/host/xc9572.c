@@ -0,0 +1,217 @@
+/*
+ * xc9572.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "crc32.h"
+#include "xc9572.h"
+
+typedef enum {
+  OP_NONE = 0,
+  OP_ERASE,
+  OP_PROGRAM
+} xc95_op_t;
+
+typedef struct {
+  uint8_t isp;              // ISC_ENABLE seen, until ISC_DISABLE (a TAP reset keeps it)
+  uint8_t op;               // xc95_op_t running
+  uint8_t status;           // captured with the next ISP register scan
+  uint64_t need;            // cycles in Run-Test/Idle the operation takes
+  uint64_t done;            // cycles it already had
+  uint8_t in_rti;
+  uint64_t rti_since;       // entered Run-Test/Idle at
+  uint32_t row_addr[XC95_ROW_WORDS];
+  uint32_t row_data[XC95_ROW_WORDS];
+  uint32_t row;             // words loaded for the next strobe
+  uint32_t read;            // word of the last ISC_READ
+  uint32_t *array;
+  XC95_STATS_ST stats;
+} XC95_ST;
+
+/* time the simulated part needs, in percent of the XC95_ERASE_US/XC95_PROGRAM_US */
+static uint32_t speed = 100;
+
+void xc95_set_speed(uint32_t percent){
+  speed = percent;
+}
+
+static uint64_t us_cycles(TAP_SIM_ST *t, uint32_t us){
+  return (uint64_t)us * speed / 100 * t->hz / 1000000;
+}
+
+/*
+ * Finishes the operation once it had its time. An erase sets all words,
+ * programming can only clear bits.
+ */
+static void op_finish(TAP_SIM_ST *t){
+  XC95_ST *x = t->priv;
+  uint32_t i;
+
+  if ((x->op == OP_NONE) || (x->done < x->need)) return;
+  if (x->op == OP_ERASE) {
+    memset(x->array, 0xff, XC95_WORDS * sizeof(uint32_t));
+  } else {
+    for (i=0; i<x->row; i++){
+      x->array[x->row_addr[i]] &= x->row_data[i];
+    }
+    x->stats.words += x->row;
+    x->row = 0;
+  }
+  x->op = OP_NONE;
+  x->status = XC95_ST_DONE;
+}
+
+static void op_start(TAP_SIM_ST *t, xc95_op_t op, uint32_t us){
+  XC95_ST *x = t->priv;
+
+  if (!x->isp) {
+    x->status = XC95_ST_ERROR;
+    x->stats.errors++;
+    return;
+  }
+  x->op = op;
+  x->need = us_cycles(t, us);
+  x->done = 0;
+  x->status = XC95_ST_BUSY;
+}
+
+/* status bits of the ISP register, BUSY as long as the operation had too little time */
+static uint8_t op_status(TAP_SIM_ST *t){
+  XC95_ST *x = t->priv;
+
+  op_finish(t);
+  if (x->op != OP_NONE) x->stats.busy++;
+  return x->status;
+}
+
+static void ispen_update(TAP_SIM_ST *t, const uint8_t *bits){
+  XC95_ST *x = t->priv;
+
+  x->isp = 1;
+  x->status = XC95_ST_DONE;
+}
+
+static void erase_capture(TAP_SIM_ST *t, uint8_t *bits){
+  memset(bits, 0, XC95_ERASE_BITS);
+  tap_put(bits, 0, XC95_CTL_BITS, op_status(t));
+}
+
+static void erase_update(TAP_SIM_ST *t, const uint8_t *bits){
+  XC95_ST *x = t->priv;
+
+  if (tap_get(bits, 0, XC95_CTL_BITS) != XC95_CTL_STROBE) return;
+  x->stats.erases++;
+  op_start(t, OP_ERASE, XC95_ERASE_US);
+}
+
+static void word_capture(TAP_SIM_ST *t, uint8_t *bits){
+  XC95_ST *x = t->priv;
+
+  memset(bits, 0, XC95_WORD_BITS);
+  tap_put(bits, 0, XC95_CTL_BITS, op_status(t));
+  if (t->ir == XC95_FVFY) tap_put(bits, XC95_CTL_BITS, XC95_DATA_BITS, x->read);
+}
+
+/* ISC_PROGRAM: LOAD collects the words of a row, STROBE programs them */
+static void program_update(TAP_SIM_ST *t, const uint8_t *bits){
+  XC95_ST *x = t->priv;
+  uint32_t ctl = tap_get(bits, 0, XC95_CTL_BITS);
+
+  if (!(ctl & XC95_CTL_LOAD)) return;
+  if (x->op != OP_NONE) {
+    /* loading while the last row is still programmed loses the row */
+    x->stats.errors++;
+    return;
+  }
+  if (x->row < XC95_ROW_WORDS) {
+    x->row_data[x->row] = tap_get(bits, XC95_CTL_BITS, XC95_DATA_BITS);
+    x->row_addr[x->row] = tap_get(bits, XC95_CTL_BITS + XC95_DATA_BITS, XC95_ADDR_BITS);
+    x->row++;
+  }
+  if (ctl == XC95_CTL_STROBE) {
+    x->stats.programs++;
+    op_start(t, OP_PROGRAM, XC95_PROGRAM_US);
+  }
+}
+
+/* ISC_READ: the addressed word comes out with the next scan */
+static void verify_update(TAP_SIM_ST *t, const uint8_t *bits){
+  XC95_ST *x = t->priv;
+
+  if (!x->isp) return;
+  x->read = x->array[tap_get(bits, XC95_CTL_BITS + XC95_DATA_BITS, XC95_ADDR_BITS)];
+  x->stats.reads++;
+}
+
+static const TAP_DR_ST xc95_drs[] = {
+  { XC95_ISPEN, 6, NULL, ispen_update },
+  { XC95_FBULK, XC95_ERASE_BITS, erase_capture, erase_update },
+  { XC95_FPGM, XC95_WORD_BITS, word_capture, program_update },
+  { XC95_FVFY, XC95_WORD_BITS, word_capture, verify_update },
+};
+
+/*
+ * An operation runs only while the TAP rests in Run-Test/Idle. ISC_DISABLE
+ * needs no data register, loading the instruction leaves ISP mode.
+ */
+static void xc95_enter(TAP_SIM_ST *t, uint8_t state){
+  XC95_ST *x = t->priv;
+
+  if (x->in_rti) {
+    if (x->op != OP_NONE) x->done += t->now - x->rti_since;
+    x->in_rti = 0;
+  }
+  if (state == TAP_RTI) {
+    x->in_rti = 1;
+    x->rti_since = t->now;
+  } else if ((state == TAP_UPDATE_IR) && (t->ir == XC95_ISPEX)) {
+    x->isp = 0;
+    x->row = 0;
+  }
+}
+
+static void xc95_init(TAP_SIM_ST *t){
+  XC95_ST *x = calloc(1, sizeof(XC95_ST));
+
+  x->array = malloc(XC95_WORDS * sizeof(uint32_t));
+  memset(x->array, 0xff, XC95_WORDS * sizeof(uint32_t));
+  t->priv = x;
+}
+
+static void xc95_release(TAP_SIM_ST *t){
+  XC95_ST *x = t->priv;
+
+  free(x->array);
+  free(x);
+  t->priv = NULL;
+}
+
+void xc95_get_stats(TAP_SIM_ST *t, XC95_STATS_ST *s){
+  *s = ((XC95_ST *)t->priv)->stats;
+}
+
+/* CRC-32/MPEG-2 of the whole array, the fingerprint of what was programmed */
+uint32_t xc95_array_crc(TAP_SIM_ST *t){
+  XC95_ST *x = t->priv;
+
+  return crc32_sw(CRC32_INIT, (const uint8_t *)x->array, XC95_WORDS * sizeof(uint32_t));
+}
+
+static void xc95_print(TAP_SIM_ST *t){
+  XC95_ST *x = t->priv;
+  XC95_STATS_ST *s = &x->stats;
+
+  printf("%-24s XC9572: %u erase, %u program strobes, %u words, %u reads, "
+      "%u busy, %u errors, array CRC %08X\n", "", s->erases, s->programs, s->words,
+      s->reads, s->busy, s->errors, xc95_array_crc(t));
+}
+
+const TAP_MODEL_ST xc9572_model = {
+  "xc9572", XC95_IR_BITS, 0x01, XC95_IDCODE, XC95_IDCODE_IR,
+  xc95_drs, sizeof(xc95_drs) / sizeof(xc95_drs[0]),
+  xc95_init, xc95_release, NULL, xc95_enter, xc95_print
+};
@@ -0,0 +1,70 @@
+/*
+ * xc9572.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_XC9572_H_
+#define HOST_XC9572_H_
+
+#include "tap_sim.h"
+
+/*
+ * Behavioural model of the XC9572 in-system programming: the instructions
+ * and the ISP register (status, data, address) an iMPACT XSVF uses, an
+ * array of 32 bit words and the erase and program times. An operation
+ * only makes progress while the TAP is in Run-Test/Idle, so a player
+ * which leaves early reads the busy status and has to XREPEAT.
+ */
+#define XC95_IDCODE      0x09604093U
+#define XC95_IR_BITS     8
+
+#define XC95_ISPEN       0xe8  // ISC_ENABLE, 6 bit DR
+#define XC95_FBULK       0xed  // bulk erase, 18 bit DR
+#define XC95_FPGM        0xea  // ISC_PROGRAM, 50 bit DR
+#define XC95_FVFY        0xee  // ISC_READ (verify), 50 bit DR
+#define XC95_ISPEX       0xf0  // ISC_DISABLE, leaves ISP mode, no DR
+#define XC95_IDCODE_IR   0xfe
+
+/* ISP register, bit 0 next to TDO: status/control (2), [data (32),] address (16) */
+#define XC95_CTL_BITS    2
+#define XC95_DATA_BITS   32
+#define XC95_ADDR_BITS   16
+#define XC95_ERASE_BITS  (XC95_CTL_BITS + XC95_ADDR_BITS)
+#define XC95_WORD_BITS   (XC95_CTL_BITS + XC95_DATA_BITS + XC95_ADDR_BITS)
+#define XC95_WORDS       (1U << XC95_ADDR_BITS)
+
+/* control in, status out */
+#define XC95_CTL_LOAD    0x1   // 01: load the word
+#define XC95_CTL_STROBE  0x3   // 11: load it and start the operation
+#define XC95_ST_DONE     0x1   // 01: the last operation is complete
+#define XC95_ST_BUSY     0x0   // 00: still running
+#define XC95_ST_ERROR    0x2   // 10: not in ISP mode
+
+/* wait times of the XC9500 family, as iMPACT puts them into XRUNTEST */
+#if !defined(XC95_ERASE_US)
+#define XC95_ERASE_US    200000
+#endif
+#if !defined(XC95_PROGRAM_US)
+#define XC95_PROGRAM_US  20000
+#endif
+
+/* words programmed with one strobe */
+#define XC95_ROW_WORDS   64
+
+typedef struct {
+  uint32_t erases;
+  uint32_t programs;    // program strobes
+  uint32_t words;       // words programmed
+  uint32_t reads;
+  uint32_t busy;        // status captured while an operation was still running
+  uint32_t errors;      // operations outside ISP mode
+} XC95_STATS_ST;
+
+extern const TAP_MODEL_ST xc9572_model;
+
+void xc95_set_speed(uint32_t percent);
+void xc95_get_stats(TAP_SIM_ST *t, XC95_STATS_ST *s);
+uint32_t xc95_array_crc(TAP_SIM_ST *t);
+
+#endif /* HOST_XC9572_H_ */
@@ -0,0 +1,348 @@
+/*
+ * xsvf_bench.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "xsvf.h"
+#include "xsvf_prof.h"
+#include "dlog.h"
+#include "jobq.h"
+#include "chprintf.h"
+#include "host_hal.h"
+#include "tap_sim.h"
+#include "xc9572.h"
+
+/*
+ * Plays XSVF files through write_xsvf() in XSVF_JOB_SIZE chunks, like the
+ * worker does with the 'X' jobs of xsvf_upload.py, against a simulated TAP
+ * and reports TCK count, instructions/s and the simulated wall time of
+ * each file. -f cuts the files into random fragments instead.
+ */
+#define BENCH_DRS 16
+
+/* the Ostrich port takes the progress bytes, the debug port goes to stderr with -v */
+static bool verbose;
+static uint32_t ost_bytes;
+
+static size_t ost_write(void *ip, const uint8_t *bp, size_t n){
+  ost_bytes += n;
+  return n;
+}
+
+static msg_t ost_put(void *ip, uint8_t b){
+  ost_bytes++;
+  return MSG_OK;
+}
+
+static size_t dbg_write(void *ip, const uint8_t *bp, size_t n){
+  if (verbose) fwrite(bp, 1, n, stderr);
+  return n;
+}
+
+static msg_t dbg_put(void *ip, uint8_t b){
+  if (verbose) fputc(b, stderr);
+  return MSG_OK;
+}
+
+static const struct BaseSequentialStreamVMT ost_vmt = { ost_write, ost_put };
+static const struct BaseSequentialStreamVMT dbg_vmt = { dbg_write, dbg_put };
+static BaseSequentialStream ost_stream = { &ost_vmt };
+static BaseSequentialStream dbg_stream = { &dbg_vmt };
+BaseSequentialStream *const ost = &ost_stream;
+BaseSequentialStream *const dbg = &dbg_stream;
+
+static TAP_DR_ST drs[BENCH_DRS];
+static TAP_MODEL_ST model = { "generic", 8, 0x01, 0, 0xfe, drs, 0, NULL, NULL, NULL, NULL, NULL };
+
+static double host_seconds(void){
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint8_t *load(const char *name, uint32_t *len){
+  FILE *f = fopen(name, "rb");
+  uint8_t *buf;
+  long n;
+
+  if (!f) return NULL;
+  fseek(f, 0, SEEK_END);
+  n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buf = malloc(n ? n : 1);
+  if (buf && fread(buf, 1, n, f) != (size_t)n) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  *len = n;
+  return buf;
+}
+
+/*
+ * Size of the instruction at pos, as inst_size() in xsvf.c and the one
+ * in xsvf_upload.py, 0 for an unknown one. Keeps track of the XSDRSIZE
+ * and of the data bits of XSETSDRMASKS.
+ */
+static uint32_t inst_next(const uint8_t *buf, uint32_t pos, uint32_t *sdr_size, uint32_t *data_bits){
+  uint32_t k, n = BYTES(*sdr_size);
+
+  switch (buf[pos]) {
+  case XCOMPLETE:
+    return 1;
+  case XREPEAT: case XSTATE: case XENDIR: case XENDDR:
+    return 2;
+  case XRUNTEST:
+    return 5;
+  case XSDRSIZE:
+    *sdr_size = (buf[pos+1] << 24) | (buf[pos+2] << 16) | (buf[pos+3] << 8) | buf[pos+4];
+    return 5;
+  case XWAIT:
+    return 7;
+  case XWAITSTATE:
+    return 11;
+  case XSIR:
+    return 2 + BYTES(buf[pos+1]);
+  case XSIR2:
+    return 3 + BYTES(((buf[pos+1] << 8) | buf[pos+2]));
+  case XTDOMASK: case XSDR: case XSDRB: case XSDRC: case XSDRE:
+    return 1 + n;
+  case XSDRTDO: case XSDRTDOB: case XSDRTDOC: case XSDRTDOE:
+    return 1 + 2*n;
+  case XSETSDRMASKS:
+    *data_bits = 0;
+    for (k=0; k<n; k++){
+      *data_bits += __builtin_popcount(buf[pos + 1 + n + k]);
+    }
+    return 1 + 2*n;
+  case XSDRINC:
+    return 2 + n + buf[pos + 1 + n] * BYTES(*data_bits);
+  default:
+    return 0;
+  }
+}
+
+/*
+ * Clears the operand of every XTDOMASK, so a file made for another target
+ * plays through with the same scans. Returns the number of masks.
+ */
+static uint32_t clear_masks(uint8_t *buf, uint32_t len){
+  uint32_t pos = 0, cleared = 0, sdr_size = 0, data_bits = 0, size;
+
+  while (pos < len){
+    size = inst_next(buf, pos, &sdr_size, &data_bits);
+    /* the player reports what can't be walked */
+    if ((size == 0) || (pos + size > len)) break;
+    if (buf[pos] == XTDOMASK) {
+      memset(&buf[pos+1], 0, size - 1);
+      cleared++;
+    }
+    pos += size;
+  }
+  return cleared;
+}
+
+/*
+ * Chunk ends regardless of the instructions, like split_file() in
+ * xsvf_upload.py: XSVF_JOB_SIZE bytes each, or with frag 1..frag bytes
+ * at random. Returns the number of chunks, the end of chunk i is ends[i].
+ */
+static uint32_t split(uint32_t len, uint32_t *ends, uint32_t frag){
+  uint32_t pos = 0, chunks = 0;
+
+  while (pos < len){
+    /* rand() isn't seeded, every run cuts the same fragments */
+    pos += frag ? 1 + rand() % frag : XSVF_JOB_SIZE;
+    ends[chunks++] = (pos < len) ? pos : len;
+  }
+  return chunks;
+}
+
+static bool add_dr(const char *arg){
+  char *end;
+  uint32_t ir, len;
+
+  ir = strtoul(arg, &end, 0);
+  if (*end != ':') return false;
+  len = strtoul(end + 1, &end, 0);
+  if (*end || !len || len > TAP_REG_MAX || model.ndrs == BENCH_DRS) return false;
+  drs[model.ndrs].ir = ir;
+  drs[model.ndrs].len = len;
+  model.ndrs++;
+  return true;
+}
+
+/* like the shell command prof, in simulated time */
+static void print_prof(void){
+  PROF_ST p;
+  uint32_t k;
+
+  prof_get(&p);
+  for (k=0; k<PROF_ENTRIES; k++){
+    if (p.e[k].count == 0) continue;
+    printf("%-24s %-12s %10u calls %12.0f us %10llu cyc/call\n", "", prof_name(k), p.e[k].count,
+        (double)p.e[k].cycles * 1e6 / STM32_SYSCLK, (unsigned long long)(p.e[k].cycles / p.e[k].count));
+  }
+}
+
+static void usage(void){
+  fprintf(stderr,
+      "usage: xsvf_bench [-M xc9572 [-S percent]] [-i irlen] [-c idcode] [-I idcode-ir] [-d ir:len]...\n"
+      "                  [-t hz] [-m] [-f max] [-p] [-w prefix] [-v] file...\n"
+      "  -M  behavioural model of the target instead of the generic TAP\n"
+      "  -S  the model takes percent of the erase/program times of the data sheet (100)\n"
+      "  -i  IR length of the simulated TAP (8)\n"
+      "  -c  IDCODE, 0 for none (0)\n"
+      "  -I  instruction which selects the IDCODE (0xfe)\n"
+      "  -d  a data register which captures what was shifted in last\n"
+      "  -t  TCK rate in Hz as set with 'D' 'W', 0 is the power-up default (0)\n"
+      "  -m  clear the XTDOMASKs, so a file made for another target plays through\n"
+      "  -f  fragments of 1..max bytes at random instead of XSVF_JOB_SIZE chunks\n"
+      "  -p  cycle profile of the player (xsvf_prof.h) for every file\n"
+      "  -w  pin trace of every file into prefix<file>.trc, see trace.h\n"
+      "  -v  debug port to stderr\n");
+  exit(2);
+}
+
+int main(int argc, char **argv){
+  TAP_SIM_ST *tap = malloc(sizeof(TAP_SIM_ST));
+  const TAP_MODEL_ST *m = &model;
+  HOST_STATS_ST h0, h1;
+  XSVF_TCK_ST tck;
+  uint64_t tck0;
+  uint32_t hz = 0, len, pos, k, chunks, inst0, insts, masked, frag = 0;
+  uint32_t *ends;
+  uint16_t res;
+  uint8_t *buf;
+  double t0, host, sim, sleep;
+  bool clear = false, profile = false;
+  const char *name, *prefix = NULL;
+  char path[1024];
+  TRACE_ST trace;
+  int c, i, failed = 0;
+
+  while ((c = getopt(argc, argv, "M:S:i:c:I:d:t:mf:pw:v")) != -1) {
+    switch (c) {
+    case 'M':
+      if (strcmp(optarg, "xc9572")) usage();
+      m = &xc9572_model;
+      break;
+    case 'S':
+      xc95_set_speed(strtoul(optarg, NULL, 0));
+      break;
+    case 'i':
+      model.ir_len = strtoul(optarg, NULL, 0);
+      if (model.ir_len < 2 || model.ir_len > TAP_IR_MAX) usage();
+      break;
+    case 'c':
+      model.idcode = strtoul(optarg, NULL, 0);
+      break;
+    case 'I':
+      model.idcode_ir = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      if (!add_dr(optarg)) usage();
+      break;
+    case 't':
+      hz = strtoul(optarg, NULL, 0);
+      break;
+    case 'm':
+      clear = true;
+      break;
+    case 'f':
+      frag = strtoul(optarg, NULL, 0);
+      if (frag == 0 || frag > UINT16_MAX) usage();
+      break;
+    case 'p':
+      profile = true;
+      break;
+    case 'w':
+      prefix = optarg;
+      break;
+    case 'v':
+      verbose = true;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (optind >= argc) usage();
+
+  /* the player calibrates its kernels while the TAP is still unplugged */
+  dlog_init();
+  xsvf_init();
+  tap_init(tap, m, STM32_SYSCLK);
+  host_attach(tap);
+  if (hz) xsvf_set_tck(hz, &tck);
+  xsvf_tck_update();
+  xsvf_get_tck(&tck);
+  printf("TAP %s, IR %u bits, IDCODE %08X, TCK %u Hz requested, kernels %u Hz\n",
+      m->name, m->ir_len, m->idcode, tck.request, tck.tck);
+  printf("%-24s %-6s %8s %11s %9s %9s %11s %9s %11s\n",
+      "file", "result", "insts", "TCK", "sim s", "sleep s", "inst/s sim", "host s", "inst/s host");
+
+  for (i=optind; i<argc; i++){
+    buf = load(argv[i], &len);
+    if (!buf) {
+      fprintf(stderr, "%s: can't read\n", argv[i]);
+      failed++;
+      continue;
+    }
+    ends = malloc((len + 1) * sizeof(uint32_t));
+    masked = clear ? clear_masks(buf, len) : 0;
+    chunks = split(len, ends, frag);
+    name = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+    if (prefix) {
+      snprintf(path, sizeof(path), "%s%s.trc", prefix, name);
+      if (!trace_open(&trace, path)) {
+        fprintf(stderr, "%s: can't write\n", path);
+        return 2;
+      }
+      host_trace(&trace);
+    }
+    xsvf_player_reset();
+    prof_clear();
+    host_get_stats(&h0);
+    tck0 = tap->tck;
+    inst0 = xsvf_executed();
+    t0 = host_seconds();
+    res = 1;
+    for (k=0, pos=0; (k < chunks) && (res == 1); pos = ends[k++]){
+      res = write_xsvf(ends[k] - pos, &buf[pos], false);
+      /* what the log thread prints on the board */
+      dlog_flush(dbg);
+    }
+    host = host_seconds() - t0;
+    if (prefix) {
+      host_trace(NULL);
+      trace_close(&trace);
+    }
+    host_get_stats(&h1);
+    insts = xsvf_executed() - inst0;
+    sim = (double)(h1.cycles - h0.cycles) / STM32_SYSCLK;
+    sleep = (double)(h1.sleep - h0.sleep) / STM32_SYSCLK;
+    printf("%-24s %-6s %8u %11llu %9.3f %9.3f %11.0f %9.3f %11.0f\n",
+        name, (res == 2) ? "done" : (res ? "short" : "FAIL"), insts,
+        (unsigned long long)(tap->tck - tck0), sim, sleep,
+        sim > 0 ? insts / sim : 0, host, host > 0 ? insts / host : 0);
+    if (masked) printf("%-24s %u TDO masks cleared\n", "", masked);
+    if (m->print) m->print(tap);
+    if (profile) print_prof();
+    if (prefix) printf("%-24s trace %s, %llu edges in %llu bytes\n", "", path,
+        (unsigned long long)trace.edges, (unsigned long long)trace.bytes);
+    if (res != 2) failed++;
+    free(ends);
+    free(buf);
+  }
+  host_attach(NULL);
+  tap_free(tap);
+  free(tap);
+  return failed ? 1 : 0;
+}
@@ -25,6 +25,8 @@
 #include "ostrich.h"
 #include "comm.h"
 #include "xsvf.h"
+#include "txq.h"
+#include "dlog.h"
 
 //#define usb_lld_connect_bus(usbp)
 //#define usb_lld_disconnect_bus(usbp)
@@ -37,7 +39,7 @@ extern THD_FUNCTION(CharacterInputThread, arg);
 /* Command line related.                                                     */
 /*===========================================================================*/
 BaseSequentialStream *const shell = (BaseSequentialStream *)&SHELLPORT;
-BaseSequentialStream *const ost = (BaseSequentialStream *)&OSTRICHPORT;
+BaseSequentialStream *const ost = &txq_stream; // written by the TX thread only
 BaseSequentialStream *const dbg = (BaseSequentialStream *)&DEBUGPORT;
 
 #define SHELL_WA_SIZE   THD_WORKING_AREA_SIZE(2048)
@@ -46,6 +48,10 @@ char *completion_buffer[SHELL_MAX_COMPLETIONS];
 
 static const ShellCommand commands[] = {
   {"test",cmd_test},
+  {"bench",cmd_bench},
+  {"ircache",cmd_ircache},
+  {"queue",cmd_queue},
+  {"prof",cmd_prof},
   {NULL, NULL}
 };
 static const ShellConfig shell_cfg1 = {
@@ -85,6 +91,9 @@ int main(void) {
   sdStart(&SHELLPORT, &serial_config6);
   palSetPadMode(GPIOA, 2, PAL_MODE_ALTERNATE(7));
   palSetPadMode(GPIOA, 3, PAL_MODE_ALTERNATE(7));
+  /* the worker and the receiver log through dlog, the log thread prints */
+  dlog_init();
+  dlog_start(dbg);
   xsvf_init();
 
   chprintf(dbg, "\r\nXSVF Player: %i.%i \r\nSystem started. (Shell)\r\n", VMAJOR, VMINOR);
@@ -0,0 +1,43 @@
+/*
+ * crc32.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_CRC32_H_
+#define USERLIB_INCLUDE_CRC32_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * CRC-32/MPEG-2, the algorithm of the STM32 CRC unit: polynomial
+ * 0x04C11DB7, initial value 0xFFFFFFFF, MSB first, no final XOR.
+ * The unit takes whole words only, the bytes of an unfinished word are
+ * added in software at the end. Host builds use the software version,
+ * which gives the same result.
+ */
+#if !defined(CRC32_USE_UNIT)
+#if defined(__arm__)
+#define CRC32_USE_UNIT  1
+#else
+#define CRC32_USE_UNIT  0
+#endif
+#endif
+
+#define CRC32_INIT      0xFFFFFFFFU
+
+/* a running CRC, with the unit only one of them at a time */
+typedef struct {
+  uint32_t crc;       // software version
+  uint8_t part[4];    // bytes of the next word for the unit
+  uint8_t bytes;
+} CRC32_ST;
+
+uint32_t crc32_sw(uint32_t crc, const uint8_t *p, size_t n);
+void crc32_init(void);
+void crc32_start(CRC32_ST *c);
+void crc32_update(CRC32_ST *c, const uint8_t *p, size_t n);
+uint32_t crc32_end(CRC32_ST *c);
+
+#endif /* USERLIB_INCLUDE_CRC32_H_ */
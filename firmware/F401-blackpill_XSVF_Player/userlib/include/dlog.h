@@ -0,0 +1,47 @@
+/*
+ * dlog.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_DLOG_H_
+#define USERLIB_INCLUDE_DLOG_H_
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+
+/*
+ * Deferred debug log: DLOG(fmt, ...) only stores the format and up to
+ * DLOG_ARGS integer arguments in a ring, the log thread formats them onto
+ * the debug port later. So a message costs the hot path a few dozen
+ * cycles instead of the milliseconds the UART takes for it.
+ * fmt must be a string constant, the arguments are integers.
+ * A full ring drops the event and counts it, it never waits.
+ */
+#if !defined(DLOG_SIZE)
+#define DLOG_SIZE     64    // events, a power of 2
+#endif
+#if !defined(DLOG_POLL_MS)
+#define DLOG_POLL_MS  10    // the log thread looks for events that often
+#endif
+#define DLOG_ARGS     3
+
+typedef struct {
+  uint32_t logged;
+  uint32_t dropped;   // ring was full
+  uint32_t most;      // most events waiting at once
+} DLOG_STATS_ST;
+
+/* DLOG(fmt) up to DLOG(fmt, a, b, c), the missing arguments are 0 */
+#define DLOG(...)  DLOG_(__VA_ARGS__, 0, 0, 0)
+#define DLOG_(fmt, a, b, c, ...) \
+  dlog_put(fmt, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c))
+
+void dlog_put(const char *fmt, uint32_t a, uint32_t b, uint32_t c);
+uint32_t dlog_flush(BaseSequentialStream *chp);
+void dlog_get_stats(DLOG_STATS_ST *s);
+void dlog_init(void);
+void dlog_start(BaseSequentialStream *chp);
+
+#endif /* USERLIB_INCLUDE_DLOG_H_ */
@@ -0,0 +1,67 @@
+/*
+ * frame.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_FRAME_H_
+#define USERLIB_INCLUDE_FRAME_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "crc32.h"
+
+/*
+ * Ostrich v2 frames: 0x00, COBS(body), 0x00
+ * body: type, seq (2), len (2), payload (len), CRC-32 (4), all MSB first,
+ * the CRC covers type to the end of the payload.
+ * COBS leaves no zero inside the frame, so a receiver which lost track
+ * is back in sync with the next 0x00.
+ */
+#define FRAME_HEAD      5
+#define FRAME_CRC       4
+#define FRAME_REPLY_MAX 16    // longest payload sent by the device
+
+/* worst case size on the wire for a payload of n bytes */
+#define FRAME_SIZE(n)   ((n) + FRAME_HEAD + FRAME_CRC + ((n) + FRAME_HEAD + FRAME_CRC) / 254 + 3)
+
+/* frame types */
+#define FRAME_ACK       'A'   // payload is the v1 answer to the request
+#define FRAME_NAK       'N'   // payload is the frame_status_t
+#define FRAME_EVENT     'E'   // answer of the worker, seq of the request which queued the job
+#define FRAME_START     'S'   // opens the 'X' window, the first chunk has seq + 1
+
+typedef enum {
+  FRAME_OK = 0,
+  FRAME_EMPTY,    // nothing but delimiters
+  FRAME_TIMEOUT,  // the host stopped sending
+  FRAME_CUT,      // a delimiter came before the end of the frame
+  FRAME_LONG,     // more bytes than the length field says
+  FRAME_BAD_CRC,
+  FRAME_REFUSED,  // good frame, but it can't be taken (type, size)
+  FRAME_GAP,      // 'X' chunk ahead of the window, one before it is missing
+  FRAME_FAILED    // 'X' chunk behind a chunk which failed to play
+} frame_status_t;
+
+/* bulk read from the link, returns the number of bytes read before the timeout */
+typedef size_t (*frame_read_t)(uint8_t *buf, size_t n);
+
+typedef struct {
+  frame_read_t read;
+  uint32_t count;   // bytes decoded
+  uint8_t left;     // literal bytes left in the COBS block
+  bool zero;        // the block ends with an implied zero
+  bool sync;        // the last byte read was a delimiter
+  uint8_t status;   // frame_status_t, the first error sticks
+  CRC32_ST crc;
+} FRAME_RX_ST;
+
+void frame_rx_start(FRAME_RX_ST *rx, frame_read_t read);
+bool frame_rx_get(FRAME_RX_ST *rx, uint8_t *dst, size_t n);
+bool frame_rx_drain(FRAME_RX_ST *rx, size_t n);
+frame_status_t frame_rx_finish(FRAME_RX_ST *rx);
+void frame_rx_resync(FRAME_RX_ST *rx);
+size_t frame_encode(uint8_t *out, uint8_t type, uint16_t seq, const uint8_t *p, uint16_t n);
+
+#endif /* USERLIB_INCLUDE_FRAME_H_ */
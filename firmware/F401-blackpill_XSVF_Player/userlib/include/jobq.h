@@ -0,0 +1,50 @@
+/*
+ * jobq.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_JOBQ_H_
+#define USERLIB_INCLUDE_JOBQ_H_
+
+#include "ch.h"
+
+#define XSVF_JOBS      2      // number of chunk buffers
+#define XSVF_JOB_SIZE  16384  // largest 'X' chunk
+
+typedef enum {
+  JOB_QUEUED = 0,
+  JOB_DONE,
+  JOB_FAILED,
+  JOB_SKIPPED   // queued behind a failed job, never played
+} job_status_t;
+
+typedef struct {
+  uint8_t type;         // XSVF_X or XSVF_Q (char_state_t)
+  uint8_t status;       // job_status_t
+  uint16_t seq;
+  uint16_t size;
+  uint8_t framed;       // queued by an Ostrich v2 frame, answered with an event frame
+  uint16_t tag;         // sequence number of that frame
+  uint8_t buf[XSVF_JOB_SIZE];
+} XSVF_JOB_ST;
+
+typedef struct {
+  uint16_t submitted;
+  uint16_t done;
+  uint16_t failed;
+  uint16_t skipped;
+  uint16_t last_seq;    // sequence number of the last finished job
+  uint8_t last_status;
+} JOBQ_STATS_ST;
+
+void jobq_init(void);
+XSVF_JOB_ST * jobq_take(sysinterval_t timeout);
+void jobq_discard(XSVF_JOB_ST *job);
+void jobq_submit(XSVF_JOB_ST *job);
+XSVF_JOB_ST * jobq_fetch(sysinterval_t timeout);
+void jobq_done(XSVF_JOB_ST *job, job_status_t status);
+uint16_t jobq_flush(void);
+void jobq_get_stats(JOBQ_STATS_ST *stats);
+
+#endif /* USERLIB_INCLUDE_JOBQ_H_ */
@@ -0,0 +1,94 @@
+/*
+ * jtag.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_JTAG_H_
+#define USERLIB_INCLUDE_JTAG_H_
+#include "ch.h"
+#include "hal.h"
+#include "jtag_pins.h"
+
+/* play with the original bit-bang shift() instead of the kernels */
+#if !defined(XSVF_SHIFT_REFERENCE)
+#define XSVF_SHIFT_REFERENCE FALSE
+#endif
+
+#define TMS 0x10
+#define TDO 0x20
+#define TDI 0x40
+#define TCK 0x80
+
+#define TDI_PIN    PAL_LINE(GPIOC, TDI_Pin) // Output
+#define TDO_PIN    PAL_LINE(GPIOB, TDO_Pin) // Input
+#define TCK_PIN    PAL_LINE(GPIOC, TCK_Pin) // Output
+#define TMS_PIN    PAL_LINE(GPIOC, TMS_Pin) // Output
+/* the host build (host/shim/hal.h) brings its own BSRR and TDO */
+#if !defined(XSVF_GPIO_BSRR)
+#define XSVF_GPIO_BSRR (GPIOC->BSRR.W)
+#endif
+#define TDI_IDLE   palClearLine  (TDI_PIN)
+#define TDI_ACTIVE palSetLine  (TDI_PIN)
+#define TMS_IDLE   palClearLine  (TMS_PIN)
+#define TMS_ACTIVE palSetLine  (TMS_PIN)
+#define TCK_IDLE   palClearLine(TCK_PIN)
+#define TCK_ACTIVE palSetLine  (TCK_PIN)
+
+/* TDO through the bit-band alias of its IDR bit, reads as 0 or 1 */
+#define BITBAND_PERIPH(addr, bit) \
+	(*(volatile uint32_t *)(PERIPH_BB_BASE + (((uint32_t)(addr) - PERIPH_BASE) << 5) + ((bit) << 2)))
+#if !defined(TDO_BB)
+#define TDO_BB     BITBAND_PERIPH(&GPIOB->IDR, TDO_Pin)
+#endif
+
+/*
+ * Long waits sleep while the timer clocks TCK (XSVF_WAIT_FREE_RUN in
+ * jtag_dma.h, on by default). Without it they sleep with TCK stopped if
+ * this is TRUE, which is fine for XC9500 and CoolRunner but not for parts
+ * that count Run-Test/Idle clocks (MAX II), or else clock TCK busy.
+ */
+#if !defined(XSVF_WAIT_SLEEP_NO_TCK)
+#define XSVF_WAIT_SLEEP_NO_TCK FALSE
+#endif
+
+/* waits from this length on sleep, the last XSVF_WAIT_GUARD_US are busy */
+#if !defined(XSVF_WAIT_SLEEP_US)
+#define XSVF_WAIT_SLEEP_US 1000
+#endif
+#if !defined(XSVF_WAIT_GUARD_US)
+#define XSVF_WAIT_GUARD_US (2 * 1000000 / CH_CFG_ST_FREQUENCY)
+#endif
+#define XSVF_WAIT_PART_US  10000000 /* 10s, well below the 32 bit cycle count wrap */
+
+/* power-up tck_wait, the uncalibrated speed of the original player */
+#define TCK_WAIT_DEFAULT 4
+
+extern uint32_t tck_wait;
+
+void wait_nops(uint32_t t);
+void set_port(uint8_t p, uint8_t val);
+void pulse_clock(void);
+void delay(uint32_t microsec);
+void jtag_wait(uint32_t microsec, uint32_t clocks);
+uint8_t read_tdo(void);
+
+/*
+ * Shift kernels: length bits from data (LSB of data[0] first) go out on
+ * TDI with TMS=0. The _exit kernels raise TMS on the last bit, which
+ * takes the TAP from Shift-xR to Exit1-xR. The _io kernels store TDO.
+ */
+void jtag_shift_out(const uint8_t *data, uint32_t length);
+void jtag_shift_out_exit(const uint8_t *data, uint32_t length);
+void jtag_shift_io(const uint8_t *data, uint8_t *tdo, uint32_t length);
+void jtag_shift_io_exit(const uint8_t *data, uint8_t *tdo, uint32_t length);
+void jtag_shift_ref(const uint8_t *data, uint8_t *tdo, uint32_t length, int exit);
+void jtag_tms(uint32_t tms, uint32_t length);
+void jtag_latch(uint32_t word);
+void jtag_calibrate(void);
+uint32_t jtag_tck_hz(uint32_t wait);
+uint32_t jtag_tck_rate(uint32_t hz, bool apply);
+
+void jtag_init(void);
+
+#endif /* USERLIB_INCLUDE_JTAG_H_ */
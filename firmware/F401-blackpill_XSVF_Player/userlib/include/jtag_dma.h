@@ -0,0 +1,62 @@
+/*
+ * jtag_dma.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_JTAG_DMA_H_
+#define USERLIB_INCLUDE_JTAG_DMA_H_
+#include "jtag.h"
+
+/*
+ * Long scans as a waveform: TIM1 paces DMA2 writes of precomputed words
+ * into the JTAG BSRR and DMA2 reads of the TDO port. The worker sleeps
+ * while the scan runs, so the USB reception keeps going.
+ */
+#if !defined(XSVF_USE_WAVE)
+#define XSVF_USE_WAVE FALSE
+#endif
+
+/* half TCK period in TIM1 ticks (84 MHz), 42 is 1 MHz TCK */
+#if !defined(XSVF_WAVE_HALF_TICKS)
+#define XSVF_WAVE_HALF_TICKS 42
+#endif
+
+/* shortest half period the two DMA streams keep up with */
+#if !defined(XSVF_WAVE_MIN_HALF)
+#define XSVF_WAVE_MIN_HALF 12
+#endif
+
+/*
+ * Long waits free-run TCK from TIM1 and DMA2 while the worker sleeps, so
+ * the other threads keep running and the TAP still sees its Run-Test/Idle
+ * clocks. Only the write stream is used, not the waveform shift engine.
+ */
+#if !defined(XSVF_WAIT_FREE_RUN)
+#define XSVF_WAIT_FREE_RUN TRUE
+#endif
+
+/* the timer clocks TCK in the waits */
+#define JTAG_DMA_CLOCK (XSVF_USE_WAVE || XSVF_WAIT_FREE_RUN)
+
+/* shorter scans stay on the GPIO kernels */
+#if !defined(XSVF_WAVE_MIN_BITS)
+#define XSVF_WAVE_MIN_BITS 32
+#endif
+
+/* bits per DMA run, longer scans are split */
+#if !defined(XSVF_WAVE_MAX_BITS)
+#define XSVF_WAVE_MAX_BITS 256
+#endif
+
+#if JTAG_DMA_CLOCK
+void jtag_dma_init(void);
+uint32_t jtag_dma_rate(uint32_t hz, bool apply);
+void jtag_dma_clock_start(void);
+void jtag_dma_clock_stop(void);
+#endif
+#if XSVF_USE_WAVE
+bool jtag_dma_shift(const uint8_t *data, uint8_t *tdo, uint32_t length, bool exit);
+#endif
+
+#endif /* USERLIB_INCLUDE_JTAG_DMA_H_ */
@@ -0,0 +1,20 @@
+/*
+ * jtag_pins.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_JTAG_PINS_H_
+#define USERLIB_INCLUDE_JTAG_PINS_H_
+
+/* pin numbers only, no HAL in here so that the host build can use it */
+#define TDI_Pin    13U  // GPIOC
+#define TCK_Pin    14U  // GPIOC
+#define TMS_Pin    15U  // GPIOC
+#define TDO_Pin    0U   // GPIOB
+
+/* BSRR words, the upper half word resets a pin */
+#define BSRR_SET(pin)    (1U << (pin))
+#define BSRR_RESET(pin)  (1U << ((pin)+16))
+
+#endif /* USERLIB_INCLUDE_JTAG_PINS_H_ */
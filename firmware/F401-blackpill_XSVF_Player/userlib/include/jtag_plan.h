@@ -0,0 +1,26 @@
+/*
+ * jtag_plan.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_JTAG_PLAN_H_
+#define USERLIB_INCLUDE_JTAG_PLAN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * How a scan of length bits is split between the SPI engine and the GPIO
+ * kernels. The vector starts at bit 0 of data[0], so the SPI part is always
+ * in front and the GPIO part takes the odd bits and the TMS=1 exit bit.
+ * No ChibiOS in here, this builds on the host as well.
+ */
+typedef struct {
+  uint32_t spi_bytes;   // data[0..spi_bytes-1] through SPI, TMS=0
+  uint32_t gpio_bits;   // the rest from data[spi_bytes] on through the kernels
+} JTAG_PLAN_ST;
+
+void jtag_plan(uint32_t length, bool exit, uint32_t min_bytes, JTAG_PLAN_ST *plan);
+
+#endif /* USERLIB_INCLUDE_JTAG_PLAN_H_ */
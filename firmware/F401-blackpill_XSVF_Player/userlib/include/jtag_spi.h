@@ -0,0 +1,36 @@
+/*
+ * jtag_spi.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_JTAG_SPI_H_
+#define USERLIB_INCLUDE_JTAG_SPI_H_
+#include "jtag.h"
+
+/*
+ * Clock the byte aligned part of long scans through SPI1 (DMA).
+ * Needs SCK1 (PA5) wired to TCK (PC14), MOSI1 (PA7) to TDI (PC13) and
+ * MISO1 (PA6) to TDO (PB0), see readme.txt.
+ */
+#if !defined(XSVF_USE_SPI)
+#define XSVF_USE_SPI FALSE
+#endif
+
+/* SPI1 runs from APB2 (84 MHz), SPI_CR1_BR_1 is /8 = 10.5 MHz TCK */
+#if !defined(XSVF_SPI_BR)
+#define XSVF_SPI_BR SPI_CR1_BR_1
+#endif
+
+/* shorter runs stay on the GPIO kernels */
+#if !defined(XSVF_SPI_MIN_BYTES)
+#define XSVF_SPI_MIN_BYTES 4
+#endif
+
+#if XSVF_USE_SPI
+void jtag_spi_init(void);
+void jtag_spi_shift(const uint8_t *data, uint8_t *tdo, uint32_t length, bool exit);
+uint32_t jtag_spi_rate(uint32_t hz, bool apply);
+#endif
+
+#endif /* USERLIB_INCLUDE_JTAG_SPI_H_ */
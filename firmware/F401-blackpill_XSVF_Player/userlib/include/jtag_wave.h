@@ -0,0 +1,26 @@
+/*
+ * jtag_wave.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_JTAG_WAVE_H_
+#define USERLIB_INCLUDE_JTAG_WAVE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "jtag_pins.h"
+
+/*
+ * Waveform for the timer/DMA engine: two BSRR words per bit, the falling
+ * edge with TMS/TDI set up and then the rising edge, plus one closing
+ * word which leaves TCK low. The engine samples the TDO port once after
+ * every word, so samples[2*i] is TDO of bit i, read just before its
+ * rising edge. No ChibiOS in here, this builds on the host as well.
+ */
+#define WAVE_WORDS(bits)  (2*(bits)+1)
+
+uint32_t wave_compile(uint32_t *words, const uint8_t *data, uint32_t length, bool exit);
+void wave_tdo(const uint16_t *samples, uint8_t *tdo, uint32_t length);
+
+#endif /* USERLIB_INCLUDE_JTAG_WAVE_H_ */
@@ -8,6 +8,8 @@
 #ifndef USERLIB_INCLUDE_OSTRICH_H_
 #define USERLIB_INCLUDE_OSTRICH_H_
 
+#include "jobq.h"
+
 typedef enum {
   IDLE = 0,
   VERSION = 1,
@@ -59,16 +61,39 @@ typedef enum {
   XSVF_Xn,
   XSVF_Xnn,
   XSVF_XnCs,
+  XSVF_Q,       //50
+  XSVF_Qn,
+  XSVF_Qnn,
+  XSVF_QnCs,
+  CLOCK_DA,
+  CLOCK_DAfCs,  //55
+  CLOCK_DP,
+  CLOCK_DPfCs,
   UNHANDLED
 } char_state_t;
 
+#define XSVF_STREAM_SIZE    4096  // stream ring, must be a power of 2
+#define XSVF_STREAM_TIMEOUT 2000  // ms without data until the player gives up
+#define OSTRICH_WINDOW      (XSVF_JOBS + 2)  // v2 'X' frames the host should keep in flight
+
+/* sliding window of the v2 'X' frames */
+typedef struct {
+  uint8_t open;
+  volatile uint8_t failed;  // a chunk failed to play, the rest is refused
+  uint16_t next;      // seq of the next chunk to queue
+  uint16_t queued;
+  uint16_t repeats;   // chunks which were sent again after a lost ACK
+  uint16_t naks;
+} OSTRICH_WIN_ST;
+
+/* payload of the short commands, XSVF chunks go into the job queue (jobq.h) */
 typedef struct {
-  uint16_t bsize1;
-  uint16_t bsize2;
   uint8_t * bufp;
-  uint8_t tbuf1[16384];
-  uint8_t tbuf2[16384];
+  uint8_t tbuf1[256];
 } BUFFER_ST;
 void start_ostrich_thread(void);
+void ostrich_get_window(OSTRICH_WIN_ST *w);
+bool ostrich_port_claim(void);
+void ostrich_port_release(void);
 
 #endif /* USERLIB_INCLUDE_OSTRICH_H_ */
@@ -0,0 +1,46 @@
+/*
+ * ring.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_RING_H_
+#define USERLIB_INCLUDE_RING_H_
+
+#include "ch.h"
+
+/*
+ * Single producer / single consumer byte ring.
+ * The producer only moves head, the consumer only moves tail, so the data
+ * path needs no lock. The semaphores are only used to block when the ring
+ * is empty (consumer) or full (producer). Size must be a power of 2.
+ */
+typedef struct {
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  volatile bool aborted;
+  uint32_t mask;
+  uint8_t * buf;
+  binary_semaphore_t data;
+  binary_semaphore_t space;
+} RING_ST;
+
+void ring_init(RING_ST *r, uint8_t *buf, uint32_t size);
+void ring_reset(RING_ST *r);
+void ring_abort(RING_ST *r);
+uint32_t ring_count(RING_ST *r);
+uint32_t ring_space(RING_ST *r);
+uint32_t ring_size(RING_ST *r);
+uint32_t ring_write(RING_ST *r, const uint8_t *data, uint32_t len);
+bool ring_put(RING_ST *r, uint8_t c, sysinterval_t timeout);
+uint8_t * ring_write_ptr(RING_ST *r, uint32_t *len);
+void ring_commit(RING_ST *r, uint32_t len);
+bool ring_wait_space(RING_ST *r, uint32_t n, sysinterval_t timeout);
+uint8_t ring_peek(RING_ST *r, uint32_t offset);
+const uint8_t * ring_read_ptr(RING_ST *r, uint32_t *len);
+const uint8_t * ring_wrap_ptr(RING_ST *r);
+void ring_skip(RING_ST *r, uint32_t len);
+uint32_t ring_read(RING_ST *r, uint8_t *data, uint32_t len);
+msg_t ring_wait(RING_ST *r, uint32_t n, sysinterval_t timeout);
+
+#endif /* USERLIB_INCLUDE_RING_H_ */
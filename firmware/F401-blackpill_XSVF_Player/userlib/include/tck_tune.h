@@ -0,0 +1,38 @@
+/*
+ * tck_tune.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_TCK_TUNE_H_
+#define USERLIB_INCLUDE_TCK_TUNE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * TCK auto-tuning: the rate is raised in steps as long as the TAP keeps
+ * answering with the same IDCODE and loops a pseudo-random pattern
+ * through BYPASS. No ChibiOS in here, the JTAG side comes in through
+ * TUNE_OPS_ST, so the sweep can run against a simulated TAP on the host.
+ */
+#define TUNE_BITS       128   // loopback pattern
+#define TUNE_MAX_DELAY  8     // devices in the chain, one BYPASS bit each
+#define TUNE_TRIES      3     // probes per step, all must pass
+#define TUNE_CACHE      4     // IDCODEs remembered
+
+typedef struct {
+  uint32_t (*set_rate)(uint32_t hz);   // returns the achieved rate
+  /* IDCODE scan and BYPASS loopback of pattern (TUNE_BITS) into tdo */
+  bool (*probe)(const uint8_t *pattern, uint8_t *tdo, uint32_t *idcode);
+} TUNE_OPS_ST;
+
+void tune_pattern(uint8_t *p, uint32_t bits, uint32_t seed);
+int tune_check(const uint8_t *pattern, const uint8_t *tdo, uint32_t bits);
+bool tune_idcode_valid(uint32_t idcode);
+uint32_t tune_sweep(const TUNE_OPS_ST *ops, uint32_t min_hz, uint32_t max_hz,
+                    uint32_t margin, uint32_t *idcode);
+uint32_t tune_cache_get(uint32_t idcode);
+void tune_cache_put(uint32_t idcode, uint32_t hz);
+
+#endif /* USERLIB_INCLUDE_TCK_TUNE_H_ */
@@ -0,0 +1,46 @@
+/*
+ * txq.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_TXQ_H_
+#define USERLIB_INCLUDE_TXQ_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#define TXQ_MSGS      16    // queued responses
+#define TXQ_MSG_SIZE  32    // a v2 frame fits, longer short writes take several
+#define TXQ_PACKET    64    // USB full-speed bulk packet
+
+/*
+ * Above the receiver (NORMALPRIO) and the XSVF worker (NORMALPRIO - 1):
+ * a reply or window ACK goes out once it is queued, not when playback
+ * blocks. The thread spends its time waiting for the USB driver.
+ */
+#define TXQ_PRIO      (NORMALPRIO + 1)
+
+typedef struct {
+  const uint8_t *p;             // bulk data of the sender, NULL for buf
+  binary_semaphore_t *done;     // signalled once the bulk data is written
+  uint16_t n;
+  uint8_t buf[TXQ_MSG_SIZE];
+} TXQ_MSG_ST;
+
+typedef struct {
+  uint32_t msgs;
+  uint32_t bulk;      // bulk writes
+  uint32_t writes;    // calls into the USB driver
+  uint32_t bytes;
+} TXQ_STATS_ST;
+
+/* all Ostrich output goes through this stream, ost points to it */
+extern BaseSequentialStream txq_stream;
+
+void txq_start(BaseChannel *chn);
+void txq_put(const uint8_t *p, size_t n);
+void txq_write(const uint8_t *p, size_t n);
+void txq_get_stats(TXQ_STATS_ST *s);
+
+#endif /* USERLIB_INCLUDE_TXQ_H_ */
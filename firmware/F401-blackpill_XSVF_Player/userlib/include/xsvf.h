@@ -9,26 +9,11 @@
 #define USERLIB_INCLUDE_XSVF_H_
 #include "ch.h"
 #include "hal.h"
-
-#define TMS 0x10
-#define TDO 0x20
-#define TDI 0x40
-#define TCK 0x80
-
-#define TDI_Pin    13U
-#define TCK_Pin    14U
-#define TMS_Pin    15U
-#define TDI_PIN    PAL_LINE(GPIOC, TDI_Pin) // Output
-#define TDO_PIN    PAL_LINE(GPIOB, 0U) // Input
-#define TCK_PIN    PAL_LINE(GPIOC, TCK_Pin) // Output
-#define TMS_PIN    PAL_LINE(GPIOC, TMS_Pin) // Output
-#define XSVF_GPIO_BSRR (GPIOC->BSRR.W)
-#define TDI_IDLE   palClearLine  (TDI_PIN)
-#define TDI_ACTIVE palSetLine  (TDI_PIN)
-#define TMS_IDLE   palClearLine  (TMS_PIN)
-#define TMS_ACTIVE palSetLine  (TMS_PIN)
-#define TCK_IDLE   palClearLine(TCK_PIN)
-#define TCK_ACTIVE palSetLine  (TCK_PIN)
+#include "ring.h"
+#include "jtag.h"
+#include "jtag_spi.h"
+#include "jtag_dma.h"
+#include "tck_tune.h"
 
 #define STATE_TLR		0x00
 #define STATE_RTI		0x01
@@ -73,13 +58,121 @@
 #define XSDRTDOC	16 // 10
 #define XSDRTDOE	17 // 11
 #define XSTATE		18 // 12
+#define XENDIR		19 // 13
+#define XENDDR		20 // 14
+#define XSIR2		21 // 15
+#define XWAIT		23 // 17
+#define XWAITSTATE	24 // 18
 
 #define PING		126 /* '~' */ 
 
 /* return number of bytes necessary for "num" bits */
-#define BYTES(num) ((int)((num+7)>>3))
+#define BYTES(num) ((uint32_t)(((uint64_t)(num)+7)>>3))
+
+/* longest XSDRSIZE, so that the operand sizes of a scan can't wrap */
+#define XSVF_SDR_MAX 0x7FFFFFF8U
+
+#define MAX_SIZE 0x20
+
+/*
+ * XSVF stores a scan operand MSB first, but the scan starts with its LSB,
+ * so no bit can go out before the whole TDI operand is in. An instruction
+ * split between two chunks, or one longer than the stream ring, is
+ * gathered into a buffer: the context's XSVF_INST_SIZE bytes for write_xsvf(),
+ * the one of the 'Q' job for stream_xsvf(). The rest play in place.
+ */
+#if !defined(XSVF_INST_SIZE)
+#define XSVF_INST_SIZE	4096
+#endif
+
+/* TDO mask and expected value kept in full up to this many bytes, a multiple of 4 */
+#if !defined(XSVF_VEC_SIZE)
+#define XSVF_VEC_SIZE	(XSVF_INST_SIZE / 2)
+#endif
+
+/* TCK auto-tuning (xsvf_autotune), margin in percent of the last good rate */
+#if !defined(XSVF_TUNE_MIN_HZ)
+#define XSVF_TUNE_MIN_HZ	100000
+#endif
+#if !defined(XSVF_TUNE_MAX_HZ)
+#define XSVF_TUNE_MAX_HZ	24000000
+#endif
+#if !defined(XSVF_TUNE_MARGIN)
+#define XSVF_TUNE_MARGIN	20
+#endif
+#define TUNE_IR_BITS		64	/* ones shifted into the IRs of the chain */
+
+/* skip an XSIR which loads the IR with the value it already holds */
+#if !defined(XSVF_IR_CACHE)
+#define XSVF_IR_CACHE		TRUE
+#endif
+
+/*
+ * A TDO mask or expected value of any length in constant space: the first
+ * XSVF_VEC_SIZE bytes (LSB first) and the byte all further ones repeat.
+ */
+typedef struct {
+	uint8_t head[XSVF_VEC_SIZE];
+	uint8_t fill;
+	uint8_t ok;		/* 0 if the bytes beyond head don't repeat fill */
+} XSVF_VEC_ST;
+
+typedef enum {
+	XSVF_FAIL = 0,
+	XSVF_OK,
+	XSVF_DONE	/* XCOMPLETE was played */
+} xsvf_result_t;
+
+/*
+ * Player state. It survives between fragments, so an instruction may be
+ * split anywhere between two calls of xsvf_feed().
+ */
+typedef struct {
+	uint8_t current_state;
+	uint8_t repeat;
+	uint32_t sdr_size;
+	uint32_t run_test;
+	uint8_t end_ir;		/* state after XSIR, XENDIR */
+	uint8_t end_dr;		/* state after a full XSDR, XENDDR */
+	XSVF_VEC_ST tdo_mask;
+	XSVF_VEC_ST tdo_expected;	/* of the last XSDRTDO, checked by XSDR */
+	uint8_t address_mask[MAX_SIZE];
+	uint8_t data_mask[MAX_SIZE];
+	uint16_t data_bits;	/* ones in data_mask, the XSDRINC data length */
+	uint8_t progress;	/* send the progress bytes after each instruction */
+	/* IR shadow: the last XSIR operand (as in the file) since Test-Logic-Reset */
+	uint8_t ir_cache;	/* skipping enabled */
+	uint8_t ir_valid;
+	uint32_t ir_bits;
+	uint8_t ir_shadow[MAX_SIZE];
+	uint32_t ir_skipped;	/* XSIR scans saved */
+	uint32_t executed;	/* instructions played */
+	/* partially received instruction */
+	uint32_t have;		/* bytes in inst[] */
+	uint32_t need;		/* size of the instruction, 0 while unknown */
+	uint8_t inst[XSVF_INST_SIZE];
+} XSVF_CTX_ST;
+
+/* TCK rate as set by the host, see xsvf_set_tck() */
+typedef struct {
+	uint32_t request;	/* Hz, 0 is the power-up default */
+	uint32_t tck;		/* achieved by the GPIO kernels */
+	uint32_t engine;	/* achieved by the SPI or timer/DMA engine, 0 if none */
+} XSVF_TCK_ST;
 
-uint16_t write_xsvf(uint16_t len, uint8_t * buf);
+void xsvf_reset(XSVF_CTX_ST *x);
+xsvf_result_t xsvf_feed(XSVF_CTX_ST *x, const uint8_t *buf, uint32_t len);
+void xsvf_player_reset(void);
+void xsvf_tap_idle(void);
+uint16_t write_xsvf(uint16_t len, uint8_t * buf, bool progress);
+uint16_t stream_xsvf(RING_ST *ring, uint8_t *spill, uint32_t spill_size, sysinterval_t timeout);
+void xsvf_set_tck(uint32_t hz, XSVF_TCK_ST *res);
+void xsvf_get_tck(XSVF_TCK_ST *res);
+void xsvf_tck_update(void);
+uint32_t xsvf_autotune(bool force, uint32_t *idcode);
+void xsvf_set_ir_cache(bool on);
+uint32_t xsvf_ir_skipped(bool *on);
+uint32_t xsvf_executed(void);
 void xsvf_init(void);
 
 #endif /* USERLIB_INCLUDE_XSVF_H_ */
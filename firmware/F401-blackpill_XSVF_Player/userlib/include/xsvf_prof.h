@@ -0,0 +1,94 @@
+/*
+ * xsvf_prof.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef USERLIB_INCLUDE_XSVF_PROF_H_
+#define USERLIB_INCLUDE_XSVF_PROF_H_
+
+#include "ch.h"
+#include "hal.h"
+
+/* count the calls and DWT cycles of the player, a few cycles per call */
+#if !defined(XSVF_PROFILE)
+#define XSVF_PROFILE TRUE
+#endif
+
+/*
+ * Profile entries: one per XSVF opcode (XCOMPLETE..XWAITSTATE), then the
+ * parts of the player. The cycles are inclusive, an XSDRTDO contains its
+ * sdr(), which contains its state_goto() and delay() calls. A single call
+ * is timed right up to 2^32 cycles (51 s), delay() books its parts.
+ */
+#define PROF_OPCODES  25
+enum {
+  PROF_SDR = PROF_OPCODES,  // DR scans with their retries and the Run-Test/Idle wait
+  PROF_STATE_GOTO,          // TAP navigation
+  PROF_DELAY,               // waits in a stable state
+  PROF_RETRY,               // XREPEAT: failed scan and the way back into Shift-DR
+  PROF_IDLE,                // between two chunks of a file, the player waits for data
+  PROF_CHUNK,               // write_xsvf() calls
+  PROF_ENTRIES
+};
+
+typedef struct {
+  uint32_t count;
+  uint64_t cycles;
+} PROF_ENTRY_ST;
+
+typedef struct {
+  systime_t since;          // last prof_clear()
+  PROF_ENTRY_ST e[PROF_ENTRIES];
+} PROF_ST;
+
+/*
+ * Binary record, big endian: PROF_ENTRIES + 1 entries of PROF_ENTRY_SIZE
+ * bytes. Entry 0 is the header
+ *   'P', PROF_VERSION, number of entries, 0, core clock Hz (4),
+ *   ms since prof_clear() (4), 0 (4),
+ * entry 1 + k holds profile entry k
+ *   k, 0, 0, 0, count (4), cycles (8).
+ */
+#define PROF_VERSION        1
+#define PROF_ENTRY_SIZE     16
+#define PROF_RECORD_SIZE    ((PROF_ENTRIES + 1) * PROF_ENTRY_SIZE)
+
+/* written by the worker thread only */
+extern PROF_ST xsvf_prof;
+
+static inline uint32_t prof_now(void){
+#if XSVF_PROFILE
+  return DWT->CYCCNT;
+#else
+  return 0;
+#endif
+}
+
+/* Cycles since t0 without a call, for the parts of a long one. */
+static inline void prof_time(uint32_t k, uint32_t t0){
+#if XSVF_PROFILE
+  xsvf_prof.e[k].cycles += DWT->CYCCNT - t0;
+#else
+  (void)k;
+  (void)t0;
+#endif
+}
+
+/* One call of entry k which started at t0. */
+static inline void prof_add(uint32_t k, uint32_t t0){
+#if XSVF_PROFILE
+  xsvf_prof.e[k].count++;
+  xsvf_prof.e[k].cycles += DWT->CYCCNT - t0;
+#else
+  (void)k;
+  (void)t0;
+#endif
+}
+
+void prof_clear(void);
+void prof_get(PROF_ST *p);
+const char * prof_name(uint32_t k);
+bool prof_entry(uint32_t idx, uint8_t *buf);
+
+#endif /* USERLIB_INCLUDE_XSVF_PROF_H_ */
@@ -17,6 +17,12 @@
 #include "shell.h"
 #include "ostrich.h"
 #include "portab.h"
+#include "jtag_spi.h"
+#include "jtag_dma.h"
+#include "xsvf.h"
+#include "xsvf_prof.h"
+#include "txq.h"
+#include "dlog.h"
 
 extern BaseSequentialStream *const ost; //OSTRICHPORT
 
@@ -40,4 +46,110 @@ void cmd_test(BaseSequentialStream *chp, int argc, char *argv[]) {
 
 }
 
+/*
+ * Cycles per bit of the shift kernels against the bit-bang reference.
+ * Refused while the player has a job or a stream. Resets the TAP and
+ * clocks 512 bits with TMS=0 in Run-Test/Idle, where it is left, so the
+ * target must not be in the middle of anything.
+ */
+void cmd_bench(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)* argv;
+  (void)argc;
+  static uint8_t data[64], tdo[64];
+  const uint32_t bits = sizeof(data) * 8;
+  uint32_t wait;
+  uint32_t t0, cref, cout, cio;
+  uint8_t pass;
+
+  if (!ostrich_port_claim()) {
+    chprintf(chp, "JTAG busy, a job is queued or playing\r\n");
+    return;
+  }
+  wait = tck_wait;
+  xsvf_tap_idle();
+  for (t0 = 0; t0 < sizeof(data); t0++) data[t0] = (uint8_t)(t0 * 37);
+  for (pass = 0; pass < 2; pass++){
+    tck_wait = pass ? 0 : wait;
+    t0 = DWT->CYCCNT;
+    jtag_shift_ref(data, tdo, bits, 0);
+    cref = DWT->CYCCNT - t0;
+    t0 = DWT->CYCCNT;
+    jtag_shift_out(data, bits);
+    cout = DWT->CYCCNT - t0;
+    t0 = DWT->CYCCNT;
+    jtag_shift_io(data, tdo, bits);
+    cio = DWT->CYCCNT - t0;
+    chprintf(chp, "tck_wait %d: cycles/bit ref %d, out %d, io %d -> %d kHz TCK\r\n",
+             tck_wait, cref / bits, cout / bits, cio / bits, STM32_SYSCLK / 1000 / (cio / bits));
+  }
+  tck_wait = wait;
+#if XSVF_USE_SPI
+  t0 = DWT->CYCCNT;
+  jtag_spi_shift(data, tdo, bits, false);
+  cio = DWT->CYCCNT - t0;
+  chprintf(chp, "spi: cycles/bit io %d\r\n", cio / bits);
+#endif
+#if XSVF_USE_WAVE
+  t0 = DWT->CYCCNT;
+  if (jtag_dma_shift(data, tdo, bits, false)) {
+    cio = DWT->CYCCNT - t0;
+    chprintf(chp, "wave: cycles/bit io %d\r\n", cio / bits);
+  } else {
+    chprintf(chp, "wave: DMA timeout/error\r\n");
+  }
+#endif
+  ostrich_port_release();
+}
+
+/* IR shadow of the player: ircache [on|off] */
+void cmd_ircache(BaseSequentialStream *chp, int argc, char *argv[]) {
+  bool on;
+  uint32_t skipped;
+
+  if (argc > 0) xsvf_set_ir_cache(strcmp(argv[0], "off") != 0);
+  skipped = xsvf_ir_skipped(&on);
+  chprintf(chp, "IR cache %s, %d XSIR scans skipped\r\n", on ? "on" : "off", skipped);
+}
+
+/* Job queue, the v2 'X' window, the TX queue and the debug log */
+void cmd_queue(BaseSequentialStream *chp, int argc, char *argv[]) {
+  (void)* argv;
+  (void)argc;
+  JOBQ_STATS_ST q;
+  OSTRICH_WIN_ST w;
+  TXQ_STATS_ST t;
+  DLOG_STATS_ST d;
+
+  jobq_get_stats(&q);
+  ostrich_get_window(&w);
+  chprintf(chp, "jobs: %d submitted, %d done, %d failed, %d skipped, last %d (%d)\r\n",
+           q.submitted, q.done, q.failed, q.skipped, q.last_seq, q.last_status);
+  chprintf(chp, "window %s%s: next %d, %d queued, %d repeated, %d NAKs\r\n",
+           w.open ? "open" : "closed", w.failed ? ", failed" : "", w.next, w.queued, w.repeats, w.naks);
+  txq_get_stats(&t);
+  chprintf(chp, "tx: %d messages, %d bulk, %d bytes in %d writes\r\n",
+           t.msgs, t.bulk, t.bytes, t.writes);
+  dlog_get_stats(&d);
+  chprintf(chp, "log: %d events, %d dropped, at most %d of %d waiting\r\n",
+           d.logged, d.dropped, d.most, DLOG_SIZE);
+}
+
+/* Cycle profile of the player: prof [clear], the times include the nested calls */
+void cmd_prof(BaseSequentialStream *chp, int argc, char *argv[]) {
+  static PROF_ST p;
+  uint32_t k, us;
+
+  prof_get(&p);
+  chprintf(chp, "%d ms since clear, %d MHz\r\n",
+           TIME_I2MS(chVTGetSystemTime() - p.since), STM32_SYSCLK / 1000000);
+  chprintf(chp, "%-12s %10s %12s %10s\r\n", "", "count", "us", "cyc/call");
+  for (k = 0; k < PROF_ENTRIES; k++){
+    if (p.e[k].count == 0) continue;
+    us = (uint32_t)(p.e[k].cycles / (STM32_SYSCLK / 1000000));
+    chprintf(chp, "%-12s %10u %12u %10u\r\n", prof_name(k), p.e[k].count, us,
+             (uint32_t)(p.e[k].cycles / p.e[k].count));
+  }
+  if ((argc > 0) && (strcmp(argv[0], "clear") == 0)) prof_clear();
+}
+
 
@@ -0,0 +1,74 @@
+/*
+ * crc32.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "crc32.h"
+#if CRC32_USE_UNIT
+#include "hal.h"
+#endif
+
+uint32_t crc32_sw(uint32_t crc, const uint8_t *p, size_t n){
+  uint8_t i;
+
+  while (n--){
+    crc ^= (uint32_t)*p++ << 24;
+    for (i=0; i<8; i++){
+      crc = (crc & 0x80000000U) ? (crc << 1) ^ 0x04C11DB7U : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+void crc32_init(void){
+#if CRC32_USE_UNIT
+  rccEnableAHB1(RCC_AHB1ENR_CRCEN, true);
+#endif
+}
+
+void crc32_start(CRC32_ST *c){
+  c->crc = CRC32_INIT;
+  c->bytes = 0;
+#if CRC32_USE_UNIT
+  CRC->CR = CRC_CR_RESET;
+#endif
+}
+
+void crc32_update(CRC32_ST *c, const uint8_t *p, size_t n){
+#if CRC32_USE_UNIT
+  uint32_t w;
+
+  /* fill up a started word first */
+  while (n && c->bytes){
+    c->part[c->bytes++] = *p++;
+    n--;
+    if (c->bytes == 4){
+      memcpy(&w, c->part, 4);
+      CRC->DR = __REV(w);
+      c->bytes = 0;
+    }
+  }
+  /* the unit takes a word MSB first, the order of the bytes in memory */
+  while (n >= 4){
+    memcpy(&w, p, 4);
+    CRC->DR = __REV(w);
+    p += 4;
+    n -= 4;
+  }
+  while (n--){
+    c->part[c->bytes++] = *p++;
+  }
+#else
+  c->crc = crc32_sw(c->crc, p, n);
+#endif
+}
+
+uint32_t crc32_end(CRC32_ST *c){
+#if CRC32_USE_UNIT
+  c->crc = crc32_sw(CRC->DR, c->part, c->bytes);
+  c->bytes = 0;
+#endif
+  return c->crc;
+}
@@ -0,0 +1,104 @@
+/*
+ * dlog.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "dlog.h"
+
+/*
+ * Ring of events with any number of writers and the log thread as the
+ * only reader. A writer claims a slot with a compare-and-swap (LDREX/STREX)
+ * on head, fills it and then publishes it through its seq: slot i holds
+ * event i while seq is i + 1 and is free for event i again while seq is i.
+ * So neither side takes a lock, and a writer preempted inside a slot only
+ * holds up the reader, not the other writers.
+ */
+typedef struct {
+  volatile uint32_t seq;
+  const char *fmt;
+  uint32_t arg[DLOG_ARGS];
+} DLOG_EV_ST;
+
+static DLOG_EV_ST ring[DLOG_SIZE];
+static uint32_t head;     // next event to claim
+static uint32_t tail;     // next event to print, log thread only
+static DLOG_STATS_ST stats;
+
+void dlog_put(const char *fmt, uint32_t a, uint32_t b, uint32_t c){
+  uint32_t pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+  DLOG_EV_ST *ev;
+
+  do {
+    ev = &ring[pos & (DLOG_SIZE - 1)];
+    if (ev->seq != pos) {
+      /* the reader is a whole ring behind */
+      __atomic_fetch_add(&stats.dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  } while (!__atomic_compare_exchange_n(&head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  ev->fmt = fmt;
+  ev->arg[0] = a;
+  ev->arg[1] = b;
+  ev->arg[2] = c;
+  __DMB(); /* the event must be visible before its seq */
+  ev->seq = pos + 1;
+  __atomic_fetch_add(&stats.logged, 1, __ATOMIC_RELAXED);
+  if (pos + 1 - tail > stats.most) stats.most = pos + 1 - tail;
+}
+
+/* Reader side: prints the waiting events to chp, returns how many. */
+uint32_t dlog_flush(BaseSequentialStream *chp){
+  static uint32_t reported;
+  DLOG_EV_ST *ev, e;
+  uint32_t n = 0, dropped;
+
+  while (1){
+    ev = &ring[tail & (DLOG_SIZE - 1)];
+    if (ev->seq != tail + 1) break;
+    e = *ev;
+    __DMB(); /* copied before the slot is handed back */
+    ev->seq = tail + DLOG_SIZE;
+    tail++;
+    chprintf(chp, e.fmt, e.arg[0], e.arg[1], e.arg[2]);
+    n++;
+  }
+  dropped = stats.dropped;
+  if (dropped != reported) {
+    chprintf(chp, "dlog: %d events dropped\r\n", dropped - reported);
+    reported = dropped;
+  }
+  return n;
+}
+
+void dlog_get_stats(DLOG_STATS_ST *s){
+  chSysLock();
+  *s = stats;
+  chSysUnlock();
+}
+
+void dlog_init(void){
+  uint32_t i;
+
+  for (i=0; i<DLOG_SIZE; i++){
+    ring[i].seq = i;
+  }
+  head = 0;
+  tail = 0;
+  memset(&stats, 0, sizeof(stats));
+}
+
+/* below the worker and the receiver, so printing never delays them */
+static THD_WORKING_AREA(waLogThread, 512);
+static THD_FUNCTION(LogThread, arg){
+  BaseSequentialStream *chp = arg;
+
+  while (true){
+    if (dlog_flush(chp) == 0) chThdSleepMilliseconds(DLOG_POLL_MS);
+  }
+}
+
+void dlog_start(BaseSequentialStream *chp){
+  chThdCreateStatic(waLogThread, sizeof(waLogThread), LOWPRIO, LogThread, chp);
+}
@@ -0,0 +1,195 @@
+/*
+ * frame.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "frame.h"
+
+/*
+ * The receiver decodes COBS on the fly: the literal bytes of a block are
+ * read in one go straight into the destination, the zero at the end of a
+ * block is only written once the next code byte shows that the frame goes
+ * on. The CRC runs over the decoded bytes piece by piece.
+ */
+void frame_rx_start(FRAME_RX_ST *rx, frame_read_t read){
+  rx->read = read;
+  rx->count = 0;
+  rx->left = 0;
+  rx->zero = false;
+  rx->sync = true;
+  rx->status = FRAME_OK;
+  crc32_start(&rx->crc);
+}
+
+static bool rx_fail(FRAME_RX_ST *rx, frame_status_t status){
+  if (rx->status == FRAME_OK) rx->status = status;
+  return false;
+}
+
+/* Reads the next code byte, false at a delimiter or timeout. */
+static bool rx_code(FRAME_RX_ST *rx, uint8_t *code){
+  do {
+    if (rx->read(code, 1) != 1) return rx_fail(rx, FRAME_TIMEOUT);
+    rx->sync = (*code == 0);
+    /* extra delimiters between frames don't count */
+  } while ((*code == 0) && (rx->count == 0) && !rx->zero);
+  if (*code == 0) return rx_fail(rx, (rx->count || rx->zero) ? FRAME_CUT : FRAME_EMPTY);
+  return true;
+}
+
+static bool rx_get(FRAME_RX_ST *rx, uint8_t *dst, size_t n, bool sum){
+  size_t k, got;
+  uint8_t code;
+  bool zero;
+
+  if (rx->status != FRAME_OK) return false;
+  while (n){
+    if (rx->left == 0){
+      zero = rx->zero;
+      if (!rx_code(rx, &code)) return false;
+      rx->left = code - 1;
+      rx->zero = (code != 0xFF);
+      if (zero){
+        *dst = 0;
+        if (sum) crc32_update(&rx->crc, dst, 1);
+        dst++;
+        n--;
+        rx->count++;
+      }
+      continue;
+    }
+    k = (n > rx->left) ? rx->left : n;
+    got = rx->read(dst, k);
+    /* a delimiter among the literals: the frame was cut, the rest belongs to the next one */
+    if (memchr(dst, 0, got) != NULL){
+      rx->sync = false;
+      return rx_fail(rx, FRAME_CUT);
+    }
+    if (got != k) return rx_fail(rx, FRAME_TIMEOUT);
+    if (sum) crc32_update(&rx->crc, dst, k);
+    rx->left -= k;
+    rx->count += k;
+    dst += k;
+    n -= k;
+  }
+  return true;
+}
+
+/* Decodes the next n bytes of the frame into dst. */
+bool frame_rx_get(FRAME_RX_ST *rx, uint8_t *dst, size_t n){
+  return rx_get(rx, dst, n, true);
+}
+
+/* Decodes and checksums n bytes which have no place to go. */
+bool frame_rx_drain(FRAME_RX_ST *rx, size_t n){
+  uint8_t tmp[32];
+  size_t k;
+
+  while (n){
+    k = (n > sizeof(tmp)) ? sizeof(tmp) : n;
+    if (!frame_rx_get(rx, tmp, k)) return false;
+    n -= k;
+  }
+  return true;
+}
+
+/* Checks the CRC and the closing delimiter once the payload was read. */
+frame_status_t frame_rx_finish(FRAME_RX_ST *rx){
+  uint8_t b[FRAME_CRC], code;
+  uint32_t crc;
+
+  if (rx->status != FRAME_OK) return (frame_status_t)rx->status;
+  crc = crc32_end(&rx->crc);
+  if (!rx_get(rx, b, sizeof(b), false)) return (frame_status_t)rx->status;
+  if (rx->left){
+    rx->sync = false;
+    rx_fail(rx, FRAME_LONG);
+  }
+  else if (rx->read(&code, 1) != 1){
+    rx_fail(rx, FRAME_TIMEOUT);
+  }
+  /* after a full block of 254 literals the encoders close with an empty one */
+  else if ((code == 1) && !rx->zero && (rx->read(&code, 1) != 1)){
+    rx_fail(rx, FRAME_TIMEOUT);
+  }
+  else if (code != 0){
+    rx->sync = false;
+    rx_fail(rx, FRAME_LONG);
+  }
+  else{
+    rx->sync = true;
+    if (crc != (((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3])){
+      rx_fail(rx, FRAME_BAD_CRC);
+    }
+  }
+  return (frame_status_t)rx->status;
+}
+
+/* Skips to the next delimiter after a broken frame. */
+void frame_rx_resync(FRAME_RX_ST *rx){
+  uint8_t c;
+
+  while (!rx->sync){
+    if (rx->read(&c, 1) != 1) return;
+    rx->sync = (c == 0);
+  }
+}
+
+typedef struct {
+  uint8_t *out;
+  size_t pos;
+  size_t code_pos;
+  uint8_t code;
+} COBS_ST;
+
+static void cobs_put(COBS_ST *e, const uint8_t *p, size_t n){
+  while (n--){
+    if (*p){
+      e->out[e->pos++] = *p;
+      e->code++;
+    }
+    if ((*p == 0) || (e->code == 0xFF)){
+      e->out[e->code_pos] = e->code;
+      e->code_pos = e->pos++;
+      e->code = 1;
+    }
+    p++;
+  }
+}
+
+/*
+ * Builds the complete frame with both delimiters in out, which must hold
+ * FRAME_SIZE(n) bytes. Returns the number of bytes to send.
+ * Uses the software CRC, the unit belongs to the receiver.
+ */
+size_t frame_encode(uint8_t *out, uint8_t type, uint16_t seq, const uint8_t *p, uint16_t n){
+  COBS_ST e;
+  uint8_t b[FRAME_HEAD];
+  uint32_t crc;
+
+  b[0] = type;
+  b[1] = (uint8_t)(seq >> 8);
+  b[2] = (uint8_t)seq;
+  b[3] = (uint8_t)(n >> 8);
+  b[4] = (uint8_t)n;
+  crc = crc32_sw(CRC32_INIT, b, FRAME_HEAD);
+  crc = crc32_sw(crc, p, n);
+
+  out[0] = 0;
+  e.out = out;
+  e.code_pos = 1;
+  e.pos = 2;
+  e.code = 1;
+  cobs_put(&e, b, FRAME_HEAD);
+  cobs_put(&e, p, n);
+  b[0] = (uint8_t)(crc >> 24);
+  b[1] = (uint8_t)(crc >> 16);
+  b[2] = (uint8_t)(crc >> 8);
+  b[3] = (uint8_t)crc;
+  cobs_put(&e, b, FRAME_CRC);
+  out[e.code_pos] = e.code;
+  out[e.pos++] = 0;
+  return e.pos;
+}
@@ -0,0 +1,102 @@
+/*
+ * jobq.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "ch.h"
+#include "jobq.h"
+
+/*
+ * Chunk queue between the Ostrich receiver and the XSVF worker.
+ * The receiver takes a free buffer, fills it and submits it, the worker
+ * plays the jobs in submission order and hands the buffer back.
+ * A submitted job can't get lost, no matter what the worker is doing.
+ */
+static objects_fifo_t jobs;
+static msg_t jobs_msg[XSVF_JOBS];
+static XSVF_JOB_ST jobs_buf[XSVF_JOBS];
+static JOBQ_STATS_ST stats;
+static uint16_t next_seq;
+
+void jobq_init(void){
+  chFifoObjectInit(&jobs, sizeof(XSVF_JOB_ST), XSVF_JOBS, jobs_buf, jobs_msg);
+  memset(&stats, 0, sizeof(stats));
+  next_seq = 0;
+}
+
+/* Receiver side: get an empty buffer, NULL on timeout. */
+XSVF_JOB_ST * jobq_take(sysinterval_t timeout){
+  XSVF_JOB_ST *job = chFifoTakeObjectTimeout(&jobs, timeout);
+  if (job){
+    job->status = JOB_QUEUED;
+    job->size = 0;
+    job->framed = 0;
+    job->tag = 0;
+  }
+  return job;
+}
+
+/* Receiver side: give back a buffer which was not submitted. */
+void jobq_discard(XSVF_JOB_ST *job){
+  chFifoReturnObject(&jobs, job);
+}
+
+/* Receiver side: queue a filled buffer behind all previous jobs. */
+void jobq_submit(XSVF_JOB_ST *job){
+  job->seq = next_seq++;
+  chSysLock();
+  stats.submitted++;
+  chSysUnlock();
+  chFifoSendObject(&jobs, job);
+}
+
+/* Worker side: get the oldest job, NULL on timeout. */
+XSVF_JOB_ST * jobq_fetch(sysinterval_t timeout){
+  void *job;
+  if (chFifoReceiveObjectTimeout(&jobs, &job, timeout) != MSG_OK) return NULL;
+  return (XSVF_JOB_ST *)job;
+}
+
+/*
+ * Worker side: record the result and release the buffer. The receiver
+ * runs above the worker and reads the stats in between, so they change
+ * under the lock.
+ */
+void jobq_done(XSVF_JOB_ST *job, job_status_t status){
+  job->status = status;
+  chSysLock();
+  switch (status){
+  case JOB_DONE:
+    stats.done++;
+    break;
+  case JOB_FAILED:
+    stats.failed++;
+    break;
+  default:
+    stats.skipped++;
+    break;
+  }
+  stats.last_seq = job->seq;
+  stats.last_status = status;
+  chSysUnlock();
+  chFifoReturnObject(&jobs, job);
+}
+
+/* Worker side: drop everything queued, e.g. after a failed job. */
+uint16_t jobq_flush(void){
+  XSVF_JOB_ST *job;
+  uint16_t n = 0;
+  while ((job = jobq_fetch(TIME_IMMEDIATE)) != NULL){
+    jobq_done(job, JOB_SKIPPED);
+    n++;
+  }
+  return n;
+}
+
+void jobq_get_stats(JOBQ_STATS_ST *s){
+  chSysLock();
+  *s = stats;
+  chSysUnlock();
+}
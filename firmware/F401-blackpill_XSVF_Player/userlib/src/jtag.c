@@ -0,0 +1,375 @@
+/*
+ * jtag.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "jtag.h"
+#include "jtag_dma.h"
+#include "xsvf_prof.h"
+
+/* half TCK period in wait_nops() loops */
+uint32_t tck_wait = TCK_WAIT_DEFAULT;
+
+/* kernel timing for CAL_BITS bits, measured by jtag_calibrate() */
+#define CAL_BITS     256
+#define CAL_WAIT     8
+#define TCK_WAIT_MAX 0xffff
+static uint32_t cal_base = CAL_BITS, cal_step = CAL_BITS; /* cycles at tck_wait 0, per tck_wait */
+
+/* TMS and TDI for the next falling TCK edge */
+static uint32_t BSRR_TMS = BSRR_RESET(TMS_Pin), BSRR_TDI = BSRR_RESET(TDI_Pin);
+
+#define TMS_MASK (BSRR_SET(TMS_Pin) | BSRR_RESET(TMS_Pin))
+#define TDI_MASK (BSRR_SET(TDI_Pin) | BSRR_RESET(TDI_Pin))
+#define TCK_LOW  BSRR_RESET(TCK_Pin)
+#define TCK_HIGH BSRR_SET(TCK_Pin)
+
+/*
+ * One row per TDI byte: the 8 BSRR words which pull TCK low with TMS=0
+ * and the TDI bit set up, LSB first. The rising edge is always TCK_HIGH.
+ */
+#define W(n, b)    (TCK_LOW | BSRR_RESET(TMS_Pin) | (((n) & (b)) ? BSRR_SET(TDI_Pin) : BSRR_RESET(TDI_Pin)))
+#define ROW(n)     { W(n, 0x01), W(n, 0x02), W(n, 0x04), W(n, 0x08), \
+                     W(n, 0x10), W(n, 0x20), W(n, 0x40), W(n, 0x80) }
+#define ROW4(n)    ROW(n), ROW((n)+1), ROW((n)+2), ROW((n)+3)
+#define ROW16(n)   ROW4(n), ROW4((n)+4), ROW4((n)+8), ROW4((n)+12)
+#define ROW64(n)   ROW16(n), ROW16((n)+16), ROW16((n)+32), ROW16((n)+48)
+
+static const uint32_t shift_words[256][8] = {
+	ROW64(0), ROW64(64), ROW64(128), ROW64(192)
+};
+
+void wait_nops(uint32_t t){
+	uint32_t i;
+	for (i=0; i<t; i++){
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+    	__NOP();
+	}
+}
+
+void set_port(uint8_t p, uint8_t val){
+	if (p == TMS && val == 0) BSRR_TMS = (1 << (TMS_Pin+16));
+	if (p == TMS && val == 1) BSRR_TMS = (1 << TMS_Pin);
+	if (p == TDI && val == 0) BSRR_TDI = (1 << (TDI_Pin+16));
+	if (p == TDI && val == 1) BSRR_TDI = (1 << TDI_Pin);
+
+	/* clock TMS and TDI on falling TCK */
+	if (p == TCK) {
+		if (val == 0) {
+			//chprintf(dbg, "Clock Low\r\n");
+			XSVF_GPIO_BSRR = BSRR_TMS | BSRR_TDI | (1 << (TCK_Pin+16));
+		} else {
+			//chprintf(dbg, "Clock Hi\r\n");
+			XSVF_GPIO_BSRR = (1 << TCK_Pin);
+		}
+	}
+}
+
+void pulse_clock(void){
+	set_port(TCK,0);
+	set_port(TCK,1);
+	wait_nops(tck_wait);
+	set_port(TCK,0);
+	wait_nops(tck_wait);
+}
+
+
+/* Busy part of a wait: TCK runs while a whole pulse still fits in. */
+static void wait_until(uint32_t t0, uint32_t cycles){
+	uint32_t pulse = STM32_SYSCLK / jtag_tck_hz(tck_wait);
+
+	while (DWT->CYCCNT - t0 + pulse < cycles) {
+		pulse_clock();
+	}
+	while (DWT->CYCCNT - t0 < cycles) {
+	}
+}
+
+/* Up to XSVF_WAIT_PART_US, so the cycle count can't wrap. */
+static void delay_part(uint32_t microsec){
+	uint32_t t0 = DWT->CYCCNT;
+	uint32_t cycles = microsec * (STM32_SYSCLK / 1000000);
+#if JTAG_DMA_CLOCK || XSVF_WAIT_SLEEP_NO_TCK
+	sysinterval_t ticks;
+
+	if (microsec >= XSVF_WAIT_SLEEP_US) {
+		/* a sleep can end up to a tick early or late, keep a guard for the busy part */
+		ticks = (sysinterval_t)((uint64_t)(microsec - XSVF_WAIT_GUARD_US) * CH_CFG_ST_FREQUENCY / 1000000);
+#if JTAG_DMA_CLOCK
+		jtag_dma_clock_start();
+		chThdSleep(ticks);
+		jtag_dma_clock_stop();
+#else
+		chThdSleep(ticks);
+#endif
+	}
+#endif
+	wait_until(t0, cycles);
+}
+
+/*
+ * Wait of microsec in a stable TAP state, timed with the DWT cycle counter.
+ * TCK runs all the time. Waits from XSVF_WAIT_SLEEP_US on sleep, so the
+ * other threads keep running, while TIM1/DMA2 free-run TCK (the default
+ * XSVF_WAIT_FREE_RUN) or with TCK stopped (XSVF_WAIT_SLEEP_NO_TCK). Only
+ * shorter waits and the end of a sleep clock TCK in a busy loop, to be exact.
+ */
+void delay(uint32_t microsec){
+	uint32_t t0 = prof_now();
+
+	set_port(TCK,0);
+	while (microsec > XSVF_WAIT_PART_US) {
+		delay_part(XSVF_WAIT_PART_US);
+		microsec -= XSVF_WAIT_PART_US;
+		prof_time(PROF_DELAY, t0);
+		t0 = prof_now();
+	}
+	if (microsec) delay_part(microsec);
+	prof_add(PROF_DELAY, t0);
+}
+
+/*
+ * At least clocks TCK cycles and at least microsec in the current state
+ * (XWAITSTATE). TMS keeps its last value, which holds a stable state.
+ */
+void jtag_wait(uint32_t microsec, uint32_t clocks){
+	uint32_t t0 = DWT->CYCCNT;
+	uint32_t us;
+
+	set_port(TCK,0);
+	while (clocks--) {
+		pulse_clock();
+	}
+	us = (DWT->CYCCNT - t0) / (STM32_SYSCLK / 1000000);
+	if (us < microsec) delay(microsec - us);
+}
+
+uint8_t read_tdo(void){
+	return (palReadLine(TDO_PIN) == PAL_HIGH) ? 1 : 0 ;
+}
+
+
+/*
+ * The original bit-bang shift, kept as the reference for the kernels.
+ * TDO is read before each bit, TDI changes with the falling edge.
+ */
+void jtag_shift_ref(const uint8_t *data, uint8_t *tdo, uint32_t length, int exit){
+	int i,j;
+	int n_bytes = (length+7)>>3;
+
+	for (i=0; i<n_bytes; i++){
+		uint8_t byte = data[i];
+		uint8_t in = 0;
+		for (j=0;j<8;j++){
+			/* on the last bit, set TMS to 1 so that we go to the EXIT state */
+			if ((length==1) && exit) {
+				set_port(TMS,1);
+			}
+			if (length>0) {
+				if (tdo) {
+					in |= read_tdo()<<j;
+				}
+				set_port(TDI, byte&1);
+				byte >>= 1;
+
+				pulse_clock();
+				length--;
+			}
+		}
+		if (tdo)
+			tdo[i] = in;
+	}
+}
+
+/* TDI/TMS set up with the falling edge, TDO sampled just before the rising edge */
+#define SHIFT_BIT(word, j) do { \
+	XSVF_GPIO_BSRR = (word); \
+	if (tck_wait) wait_nops(tck_wait); \
+	if (capture) in |= TDO_BB << (j); \
+	XSVF_GPIO_BSRR = TCK_HIGH; \
+	if (tck_wait) wait_nops(tck_wait); \
+} while (0)
+
+/* capture and exit are constants, so every caller gets its own loop */
+static inline __attribute__((always_inline))
+void shift_kernel(const uint8_t *data, uint8_t *tdo, uint32_t length,
+		const bool capture, const bool exit){
+	const uint32_t *w;
+	uint32_t word = 0;
+	uint32_t in;
+	uint32_t i, j, n;
+	uint32_t nbytes = (length - 1) >> 3; /* bytes in front of the one with the last bit */
+
+	for (i=0; i<nbytes; i++){
+		w = shift_words[data[i]];
+		in = 0;
+		SHIFT_BIT(w[0], 0);
+		SHIFT_BIT(w[1], 1);
+		SHIFT_BIT(w[2], 2);
+		SHIFT_BIT(w[3], 3);
+		SHIFT_BIT(w[4], 4);
+		SHIFT_BIT(w[5], 5);
+		SHIFT_BIT(w[6], 6);
+		SHIFT_BIT(w[7], 7);
+		if (capture) tdo[i] = in;
+	}
+
+	/* the last 1..8 bits, on the very last one TMS may leave the shift state */
+	w = shift_words[data[nbytes]];
+	n = length - (nbytes << 3);
+	in = 0;
+	for (j=0; j<n; j++){
+		word = w[j];
+		if (exit && (j == n-1)) word = (word & ~TMS_MASK) | BSRR_SET(TMS_Pin);
+		SHIFT_BIT(word, j);
+	}
+	if (capture) tdo[nbytes] = in;
+
+	/* TCK idles low, TMS and TDI keep the value of the last bit */
+	XSVF_GPIO_BSRR = word;
+	BSRR_TMS = word & TMS_MASK;
+	BSRR_TDI = word & TDI_MASK;
+}
+
+void jtag_shift_out(const uint8_t *data, uint32_t length){
+	if (length) shift_kernel(data, NULL, length, false, false);
+}
+
+void jtag_shift_out_exit(const uint8_t *data, uint32_t length){
+	if (length) shift_kernel(data, NULL, length, false, true);
+}
+
+void jtag_shift_io(const uint8_t *data, uint8_t *tdo, uint32_t length){
+	if (length) shift_kernel(data, tdo, length, true, false);
+}
+
+void jtag_shift_io_exit(const uint8_t *data, uint8_t *tdo, uint32_t length){
+	if (length) shift_kernel(data, tdo, length, true, true);
+}
+
+/*
+ * TAP navigation burst: length bits of tms (LSB first) with TDI held, at
+ * the kernel rate. TCK idles low, TMS keeps the value of the last bit.
+ */
+void jtag_tms(uint32_t tms, uint32_t length){
+	uint32_t word = TCK_LOW | BSRR_TMS | BSRR_TDI;
+
+	for (; length; length--){
+		word = TCK_LOW | BSRR_TDI | ((tms & 1) ? BSRR_SET(TMS_Pin) : BSRR_RESET(TMS_Pin));
+		XSVF_GPIO_BSRR = word;
+		if (tck_wait) wait_nops(tck_wait);
+		XSVF_GPIO_BSRR = TCK_HIGH;
+		if (tck_wait) wait_nops(tck_wait);
+		tms >>= 1;
+	}
+	XSVF_GPIO_BSRR = word;
+	BSRR_TMS = word & TMS_MASK;
+}
+
+/* TMS and TDI as left behind by an engine which drove the pins itself */
+void jtag_latch(uint32_t word){
+	BSRR_TMS = word & TMS_MASK;
+	BSRR_TDI = word & TDI_MASK;
+}
+
+/*
+ * Times jtag_shift_out(), the fastest kernel. TCK, TDI and TMS are inputs
+ * meanwhile, so nothing reaches the target. The best of a few runs is
+ * taken, an interrupt can only make a run longer.
+ */
+static uint32_t cal_cycles(uint32_t wait){
+	static const uint8_t pattern[CAL_BITS/8];
+	uint32_t i, t0, t, best = UINT32_MAX;
+
+	tck_wait = wait;
+	for (i=0; i<3; i++){
+		t0 = DWT->CYCCNT;
+		jtag_shift_out(pattern, CAL_BITS);
+		t = DWT->CYCCNT - t0;
+		if (t < best) best = t;
+	}
+	return best;
+}
+
+/* Measures the kernel timing, so that a TCK rate can be turned into a tck_wait. */
+void jtag_calibrate(void){
+	uint32_t wait = tck_wait;
+	uint32_t c0, c1;
+
+	palSetLineMode(TCK_PIN, PAL_MODE_INPUT_PULLDOWN);
+	palSetLineMode(TDI_PIN, PAL_MODE_INPUT_PULLDOWN);
+	palSetLineMode(TMS_PIN, PAL_MODE_INPUT_PULLDOWN);
+	c0 = cal_cycles(0);
+	c1 = cal_cycles(CAL_WAIT);
+	TDI_IDLE;
+	TMS_IDLE;
+	TCK_IDLE;
+	jtag_latch(BSRR_RESET(TMS_Pin) | BSRR_RESET(TDI_Pin));
+	palSetLineMode(TDI_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+	palSetLineMode(TMS_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+	palSetLineMode(TCK_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+	tck_wait = wait;
+
+	cal_base = c0;
+	cal_step = (c1 > c0) ? (c1 - c0) / CAL_WAIT : 1;
+}
+
+/* TCK rate of the kernels at a given tck_wait. */
+uint32_t jtag_tck_hz(uint32_t wait){
+	return (uint32_t)((uint64_t)STM32_SYSCLK * CAL_BITS / (cal_base + (uint64_t)wait * cal_step));
+}
+
+/*
+ * The fastest kernel rate which does not exceed hz, 0 is the power-up
+ * default. Returns the achieved rate, apply makes it the current one.
+ */
+uint32_t jtag_tck_rate(uint32_t hz, bool apply){
+	uint64_t cycles;
+	uint32_t wait = TCK_WAIT_DEFAULT;
+
+	if (hz) {
+		cycles = ((uint64_t)STM32_SYSCLK * CAL_BITS + hz - 1) / hz;
+		wait = 0;
+		if (cycles > cal_base) {
+			cycles = (cycles - cal_base + cal_step - 1) / cal_step;
+			wait = (cycles > TCK_WAIT_MAX) ? TCK_WAIT_MAX : (uint32_t)cycles;
+		}
+	}
+	if (apply) tck_wait = wait;
+	return jtag_tck_hz(wait);
+}
+
+void jtag_init(void){
+  /* the cycle counter is used for the TCK calibration and the shell benchmark */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  palSetLineMode(TDO_PIN, PAL_MODE_INPUT_PULLDOWN);
+  TDI_IDLE;
+  TMS_IDLE;
+  TCK_IDLE;
+  palSetLineMode(TDI_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+  palSetLineMode(TMS_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+  palSetLineMode(TCK_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+
+  jtag_calibrate();
+}
@@ -0,0 +1,187 @@
+/*
+ * jtag_dma.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "jtag_dma.h"
+#include "jtag_wave.h"
+#include "dlog.h"
+
+#if JTAG_DMA_CLOCK
+
+/* only DMA2 reaches the GPIO ports: TIM1_UP is stream 5, TIM1_CH1 stream 1, both channel 6 */
+#define WAVE_WR_STREAM  STM32_DMA_STREAM_ID(2, 5)
+#define WAVE_RD_STREAM  STM32_DMA_STREAM_ID(2, 1)
+#define WAVE_DMA_CHN    6
+#define WAVE_DMA_PRIO   2
+#define WAVE_IRQ_PRIO   7
+#define WAVE_TIMEOUT    TIME_MS2I(100)
+
+static const stm32_dma_stream_t *wr_dma;
+static uint32_t wave_half = XSVF_WAVE_HALF_TICKS;
+
+#if XSVF_USE_WAVE
+
+#if (XSVF_WAVE_MAX_BITS & 7) != 0
+#error "XSVF_WAVE_MAX_BITS must be a multiple of 8"
+#endif
+
+static uint32_t wave_words[WAVE_WORDS(XSVF_WAVE_MAX_BITS)];
+static uint16_t wave_samples[WAVE_WORDS(XSVF_WAVE_MAX_BITS)];
+static const stm32_dma_stream_t *rd_dma;
+static thread_reference_t wave_tr;
+
+/* the last sample is in, so the last word went out before it */
+static void wave_end(void *p, uint32_t flags){
+  (void)p;
+  TIM1->CR1 = 0;
+  TIM1->DIER = 0;
+  chSysLockFromISR();
+  chThdResumeI(&wave_tr, (flags & STM32_DMA_ISR_TEIF) ? MSG_RESET : MSG_OK);
+  chSysUnlockFromISR();
+}
+
+/*
+ * Every update event writes the next word, CC1 half a tick period later
+ * samples the TDO port, so the sample follows its word.
+ */
+static msg_t wave_run(uint32_t n){
+  msg_t msg;
+
+  dmaStreamSetMemory0(wr_dma, wave_words);
+  dmaStreamSetTransactionSize(wr_dma, n);
+  dmaStreamSetMode(wr_dma, STM32_DMA_CR_CHSEL(WAVE_DMA_CHN) | STM32_DMA_CR_PL(WAVE_DMA_PRIO) |
+                   STM32_DMA_CR_DIR_M2P | STM32_DMA_CR_MINC |
+                   STM32_DMA_CR_PSIZE_WORD | STM32_DMA_CR_MSIZE_WORD);
+  dmaStreamSetMemory0(rd_dma, wave_samples);
+  dmaStreamSetTransactionSize(rd_dma, n);
+  dmaStreamSetMode(rd_dma, STM32_DMA_CR_CHSEL(WAVE_DMA_CHN) | STM32_DMA_CR_PL(WAVE_DMA_PRIO) |
+                   STM32_DMA_CR_DIR_P2M | STM32_DMA_CR_MINC |
+                   STM32_DMA_CR_PSIZE_HWORD | STM32_DMA_CR_MSIZE_HWORD |
+                   STM32_DMA_CR_TCIE | STM32_DMA_CR_TEIE);
+
+  chSysLock();
+  dmaStreamEnable(wr_dma);
+  dmaStreamEnable(rd_dma);
+  TIM1->ARR = wave_half - 1;
+  TIM1->CCR1 = wave_half / 2;
+  TIM1->CNT = 0;
+  TIM1->SR = 0;
+  TIM1->DIER = TIM_DIER_UDE | TIM_DIER_CC1DE;
+  TIM1->EGR = TIM_EGR_UG;   /* first word right now */
+  TIM1->CR1 = TIM_CR1_URS | TIM_CR1_CEN;
+  msg = chThdSuspendTimeoutS(&wave_tr, WAVE_TIMEOUT);
+  chSysUnlock();
+
+  TIM1->CR1 = 0;
+  TIM1->DIER = 0;
+  dmaStreamDisable(wr_dma);
+  dmaStreamDisable(rd_dma);
+  return msg;
+}
+#endif /* XSVF_USE_WAVE */
+
+/*
+ * TCK free-running out of a circular two word buffer, keeps the TAP
+ * clocked while the thread sleeps in a wait. TMS is left alone, so the
+ * TAP stays in the stable state it is in.
+ */
+void jtag_dma_clock_start(void){
+  static const uint32_t clock_words[2] = {
+    BSRR_RESET(TCK_Pin), BSRR_SET(TCK_Pin)
+  };
+
+  dmaStreamSetMemory0(wr_dma, clock_words);
+  dmaStreamSetTransactionSize(wr_dma, 2);
+  dmaStreamSetMode(wr_dma, STM32_DMA_CR_CHSEL(WAVE_DMA_CHN) | STM32_DMA_CR_PL(WAVE_DMA_PRIO) |
+                   STM32_DMA_CR_DIR_M2P | STM32_DMA_CR_MINC | STM32_DMA_CR_CIRC |
+                   STM32_DMA_CR_PSIZE_WORD | STM32_DMA_CR_MSIZE_WORD);
+  dmaStreamEnable(wr_dma);
+  TIM1->ARR = wave_half - 1;
+  TIM1->CNT = 0;
+  TIM1->SR = 0;
+  TIM1->DIER = TIM_DIER_UDE;
+  TIM1->EGR = TIM_EGR_UG;
+  TIM1->CR1 = TIM_CR1_URS | TIM_CR1_CEN;
+}
+
+/* TCK ends low, an extra falling edge does nothing to the TAP */
+void jtag_dma_clock_stop(void){
+  TIM1->CR1 = 0;
+  TIM1->DIER = 0;
+  dmaStreamDisable(wr_dma);
+  XSVF_GPIO_BSRR = BSRR_RESET(TCK_Pin);
+}
+
+#if XSVF_USE_WAVE
+/*
+ * Returns false if a DMA run timed out or failed, the TAP state and TDO
+ * are unknown then and the rest of the scan is not shifted.
+ */
+bool jtag_dma_shift(const uint8_t *data, uint8_t *tdo, uint32_t length, bool exit){
+  uint32_t bits, n;
+
+  if (length < XSVF_WAVE_MIN_BITS){
+    if (exit) {
+      if (tdo) jtag_shift_io_exit(data, tdo, length);
+      else jtag_shift_out_exit(data, length);
+    } else {
+      if (tdo) jtag_shift_io(data, tdo, length);
+      else jtag_shift_out(data, length);
+    }
+    return true;
+  }
+  while (length){
+    bits = (length > XSVF_WAVE_MAX_BITS) ? XSVF_WAVE_MAX_BITS : length;
+    n = wave_compile(wave_words, data, bits, exit && bits == length);
+    if (wave_run(n) != MSG_OK) {
+      DLOG("JTAG wave timeout/error\r\n");
+      jtag_latch(BSRR_RESET(TMS_Pin) | BSRR_RESET(TDI_Pin));
+      return false;
+    }
+    if (tdo) {
+      wave_tdo(wave_samples, tdo, bits);
+      tdo += bits >> 3;
+    }
+    jtag_latch(wave_words[n-1]);
+    data += bits >> 3;
+    length -= bits;
+  }
+  return true;
+}
+#endif /* XSVF_USE_WAVE */
+
+/*
+ * The fastest rate which does not exceed hz, limited by what the DMA can
+ * keep up with (XSVF_WAVE_MIN_HALF). hz 0 is XSVF_WAVE_HALF_TICKS.
+ */
+uint32_t jtag_dma_rate(uint32_t hz, bool apply){
+  uint32_t half = XSVF_WAVE_HALF_TICKS;
+
+  if (hz) {
+    half = (STM32_TIMCLK2 + 2 * hz - 1) / (2 * hz);
+    if (half < XSVF_WAVE_MIN_HALF) half = XSVF_WAVE_MIN_HALF;
+    if (half > 0x10000) half = 0x10000;
+  }
+  if (apply) wave_half = half;
+  return STM32_TIMCLK2 / (2 * half);
+}
+
+void jtag_dma_init(void){
+  rccEnableTIM1(true);
+  rccResetTIM1();
+  TIM1->PSC = 0;
+  TIM1->CCMR1 = 0;  /* frozen compare, only the DMA request is used */
+
+  wr_dma = dmaStreamAlloc(WAVE_WR_STREAM, 0, NULL, NULL);
+  osalDbgAssert(wr_dma != NULL, "wave DMA write stream not free");
+  dmaStreamSetPeripheral(wr_dma, &XSVF_GPIO_BSRR);
+#if XSVF_USE_WAVE
+  rd_dma = dmaStreamAlloc(WAVE_RD_STREAM, WAVE_IRQ_PRIO, wave_end, NULL);
+  osalDbgAssert(rd_dma != NULL, "wave DMA read stream not free");
+  dmaStreamSetPeripheral(rd_dma, &GPIOB->IDR);
+#endif
+}
+
+#endif /* JTAG_DMA_CLOCK */
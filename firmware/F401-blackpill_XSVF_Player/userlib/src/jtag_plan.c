@@ -0,0 +1,18 @@
+/*
+ * jtag_plan.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "jtag_plan.h"
+
+/* Runs shorter than min_bytes are not worth switching the pins for. */
+void jtag_plan(uint32_t length, bool exit, uint32_t min_bytes, JTAG_PLAN_ST *plan){
+  uint32_t bytes = length >> 3;
+
+  /* SPI can't raise TMS, the exit bit has to stay behind for the GPIO */
+  if (exit && length && (length & 7) == 0) bytes--;
+  if (bytes < min_bytes) bytes = 0;
+  plan->spi_bytes = bytes;
+  plan->gpio_bits = length - (bytes << 3);
+}
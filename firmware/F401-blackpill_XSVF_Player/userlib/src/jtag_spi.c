@@ -0,0 +1,100 @@
+/*
+ * jtag_spi.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "jtag_spi.h"
+#include "jtag_plan.h"
+
+#if XSVF_USE_SPI
+
+#define SCK_PIN    PAL_LINE(GPIOA, 5U) // wired to TCK
+#define MISO_PIN   PAL_LINE(GPIOA, 6U) // wired to TDO
+#define MOSI_PIN   PAL_LINE(GPIOA, 7U) // wired to TDI
+
+/*
+ * Mode 0, LSB first: TDI changes with the falling edge and TDO is sampled
+ * with the rising edge, like the GPIO kernels. SCK idles low like TCK.
+ */
+static SPIConfig spicfg = {
+  .cr1 = SPI_CR1_LSBFIRST | XSVF_SPI_BR,
+  .cr2 = 0
+};
+
+/* runs shorter than this stay on the GPIO, UINT32_MAX while SPI is too fast */
+static uint32_t spi_min_bytes = XSVF_SPI_MIN_BYTES;
+
+/* TCK and TDI go to SPI1, TMS stays on the GPIO and remains low */
+static void spi_pins(void){
+  palSetLineMode(TCK_PIN, PAL_MODE_INPUT_PULLDOWN);
+  palSetLineMode(TDI_PIN, PAL_MODE_INPUT_PULLDOWN);
+  palSetLineMode(SCK_PIN, PAL_MODE_ALTERNATE(5) | PAL_STM32_OSPEED_HIGHEST);
+  palSetLineMode(MOSI_PIN, PAL_MODE_ALTERNATE(5) | PAL_STM32_OSPEED_HIGHEST);
+}
+
+/* back to the GPIO, the TCK latch is still low from the last kernel */
+static void gpio_pins(void){
+  palSetLineMode(SCK_PIN, PAL_MODE_INPUT_PULLDOWN);
+  palSetLineMode(MOSI_PIN, PAL_MODE_INPUT_PULLDOWN);
+  palSetLineMode(TCK_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+  palSetLineMode(TDI_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+}
+
+void jtag_spi_shift(const uint8_t *data, uint8_t *tdo, uint32_t length, bool exit){
+  JTAG_PLAN_ST plan;
+
+  jtag_plan(length, exit, spi_min_bytes, &plan);
+  if (plan.spi_bytes){
+    spi_pins();
+    if (tdo) {
+      spiExchange(&SPID1, plan.spi_bytes, data, tdo);
+      tdo += plan.spi_bytes;
+    } else {
+      spiSend(&SPID1, plan.spi_bytes, data);
+    }
+    gpio_pins();
+    data += plan.spi_bytes;
+  }
+  if (plan.gpio_bits == 0) return;
+  if (exit) {
+    if (tdo) jtag_shift_io_exit(data, tdo, plan.gpio_bits);
+    else jtag_shift_out_exit(data, plan.gpio_bits);
+  } else {
+    if (tdo) jtag_shift_io(data, tdo, plan.gpio_bits);
+    else jtag_shift_out(data, plan.gpio_bits);
+  }
+}
+
+/*
+ * SCK is APB2/2 .. APB2/256, the fastest which does not exceed hz is taken.
+ * Below APB2/256 the SPI is not used at all and 0 is returned. hz 0 is
+ * XSVF_SPI_BR. Only apply while no scan is running.
+ */
+uint32_t jtag_spi_rate(uint32_t hz, bool apply){
+  uint32_t br = XSVF_SPI_BR / SPI_CR1_BR_0;
+
+  if (hz) {
+    for (br = 0; br < 8; br++){
+      if ((STM32_PCLK2 >> (br + 1)) <= hz) break;
+    }
+  }
+  if (apply) {
+    spi_min_bytes = (br < 8) ? XSVF_SPI_MIN_BYTES : UINT32_MAX;
+    if (br < 8) {
+      spiStop(&SPID1);
+      spicfg.cr1 = SPI_CR1_LSBFIRST | (br * SPI_CR1_BR_0);
+      spiStart(&SPID1, &spicfg);
+    }
+  }
+  return (br < 8) ? STM32_PCLK2 >> (br + 1) : 0;
+}
+
+void jtag_spi_init(void){
+  /* the board file starts PA5..PA7 as AF5, keep them off the JTAG lines */
+  gpio_pins();
+  palSetLineMode(MISO_PIN, PAL_MODE_ALTERNATE(5));
+  spiStart(&SPID1, &spicfg);
+}
+
+#endif /* XSVF_USE_SPI */
@@ -0,0 +1,38 @@
+/*
+ * jtag_wave.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "jtag_wave.h"
+
+/* Returns the number of words, WAVE_WORDS(length). */
+uint32_t wave_compile(uint32_t *words, const uint8_t *data, uint32_t length, bool exit){
+  uint32_t i, word = BSRR_RESET(TCK_Pin) | BSRR_RESET(TMS_Pin) | BSRR_RESET(TDI_Pin);
+
+  for (i=0; i<length; i++){
+    word = BSRR_RESET(TCK_Pin);
+    word |= (data[i>>3] & (1 << (i&7))) ? BSRR_SET(TDI_Pin) : BSRR_RESET(TDI_Pin);
+    /* on the last bit TMS goes to 1, so that we go to the EXIT state */
+    word |= (exit && i == length-1) ? BSRR_SET(TMS_Pin) : BSRR_RESET(TMS_Pin);
+    *words++ = word;
+    *words++ = BSRR_SET(TCK_Pin);
+  }
+  /* TCK idles low, TMS and TDI keep the value of the last bit */
+  *words = word;
+  return WAVE_WORDS(length);
+}
+
+/* Packs TDO out of the port samples, LSB of tdo[0] first. */
+void wave_tdo(const uint16_t *samples, uint8_t *tdo, uint32_t length){
+  uint32_t i;
+  uint8_t in = 0;
+
+  for (i=0; i<length; i++){
+    in |= ((samples[2*i] >> TDO_Pin) & 1) << (i&7);
+    if ((i&7) == 7 || i == length-1){
+      tdo[i>>3] = in;
+      in = 0;
+    }
+  }
+}
@@ -15,12 +15,31 @@
 #include "chprintf.h"
 #include "usbcfg.h"
 #include "xsvf.h"
+#include "xsvf_prof.h"
+#include "dlog.h"
+#include "jobq.h"
+#include "frame.h"
+#include "txq.h"
+
+/* a frame must go out as one message, so frames of both threads never mix */
+#if FRAME_SIZE(FRAME_REPLY_MAX) > TXQ_MSG_SIZE
+#error "TXQ_MSG_SIZE too small for a v2 frame"
+#endif
 
 extern BaseSequentialStream *const ost;
 extern BaseSequentialStream *const dbg;
 //static uint8_t tbuf1[16384], tbuf2[16384], index;
 static BUFFER_ST buffers;
+static uint8_t stream_buf[XSVF_STREAM_SIZE];
+static RING_ST stream;
+static volatile bool streaming = false;
+static mutex_t port_mtx;         // the JTAG port, held by the worker for a job
+static XSVF_JOB_ST *job = NULL;  // job being received
+static OSTRICH_WIN_ST win;       // owned by the receiver, but for failed
+static bool win_nak;             // the missing chunk was already NAKed
+static systime_t win_last;       // end of the last frame
 static uint8_t serial[]={10,1,2,3,4,5,6,7,8};
+static uint8_t prof_buf[PROF_RECORD_SIZE + 1]; // v1 'D' 'P' answer
 
 void debug_print_state(char * text, uint8_t val){
   if (DEBUGLEVEL >= 3){
@@ -201,6 +220,14 @@ void debug_print_state(char * text, uint8_t val){
       chprintf(dbg, "%s", text);
       chprintf(dbg, "CLOCK_DWnCs\r\n");
       break;
+    case CLOCK_DA:
+      chprintf(dbg, "%s", text);
+      chprintf(dbg, "CLOCK_DA\r\n");
+      break;
+    case CLOCK_DAfCs:
+      chprintf(dbg, "%s", text);
+      chprintf(dbg, "CLOCK_DAfCs\r\n");
+      break;
     case PINS_C:
       chprintf(dbg, "%s", text);
       chprintf(dbg, "PINS_C\r\n");
@@ -229,6 +256,22 @@ void debug_print_state(char * text, uint8_t val){
       chprintf(dbg, "%s", text);
       chprintf(dbg, "XSVF_XnCs\r\n");
       break;
+    case XSVF_Q:
+      chprintf(dbg, "%s", text);
+      chprintf(dbg, "XSVF_Q\r\n");
+      break;
+    case XSVF_Qn:
+      chprintf(dbg, "%s", text);
+      chprintf(dbg, "XSVF_Qn\r\n");
+      break;
+    case XSVF_Qnn:
+      chprintf(dbg, "%s", text);
+      chprintf(dbg, "XSVF_Qnn\r\n");
+      break;
+    case XSVF_QnCs:
+      chprintf(dbg, "%s", text);
+      chprintf(dbg, "XSVF_QnCs\r\n");
+      break;
     default:
       chprintf(dbg, "%s", text);
       chprintf(dbg, "UNHANDLED\r\n");
@@ -243,34 +286,397 @@ void debug_print_val1(char * text, uint16_t val){
   }
 }
 
-thread_reference_t worktp = NULL;
-
 //extern uint8_t buffer[256];
-static THD_WORKING_AREA(waWorkThread, 256);
+static uint32_t get_be32(const uint8_t *p){
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_be32(uint8_t *p, uint32_t v){
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+/* Sends an Ostrich v2 frame, n is at most FRAME_REPLY_MAX. */
+static void frame_send(uint8_t type, uint16_t seq, const uint8_t *p, uint16_t n){
+  uint8_t f[FRAME_SIZE(FRAME_REPLY_MAX)];
+
+  txq_put(f, frame_encode(f, type, seq, p, n));
+}
+
+/* The answer of the worker: plain bytes for v1, an event frame for v2. */
+static void job_answer(XSVF_JOB_ST *wjob, const uint8_t *p, uint16_t n){
+  if (wjob->framed){
+    frame_send(FRAME_EVENT, wjob->tag, p, n);
+  }
+  else{
+    streamWrite(ost, p, n);
+  }
+}
+
+static THD_WORKING_AREA(waWorkThread, 1024);
 static THD_FUNCTION(WorkThread, arg){
   (void)arg;
+  XSVF_JOB_ST *wjob;
+  job_status_t status;
+  uint32_t hz, idcode;
+  uint8_t reply[9], i;
+  uint16_t res;
   while (true){
-    msg_t msg = chThdSuspendS(&worktp);
-    switch (msg){
+    wjob = jobq_fetch(TIME_MS2I(XSVF_STREAM_TIMEOUT));
+    chMtxLock(&port_mtx);
+    if (wjob == NULL){
+      /* upload paused or abandoned, a new one starts with an opcode */
+      xsvf_player_reset();
+      chMtxUnlock(&port_mtx);
+      continue;
+    }
+    status = JOB_DONE;
+    switch (wjob->type){
       case XSVF_X:
-        chprintf(dbg, "XSVF Programming Chunk.... %d\r\n", msg);    
-        chThdSleepMilliseconds(1000); //do something for 1s
-        chprintf(dbg, "XSVF Done. %d\r\n", msg);    
+        DLOG("XSVF Programming Chunk.... %d\r\n", wjob->seq);
+        /* the progress bytes would break up the v2 frames */
+        res = write_xsvf(wjob->size, wjob->buf, !wjob->framed);
+        if (res == 0){
+          status = JOB_FAILED;
+          if (wjob->framed) win.failed = 1; // the chunks in flight are refused
+          job_answer(wjob, (const uint8_t *)"X", 1); // Programming Error
+        }
+        else if (res == 2){
+          job_answer(wjob, (const uint8_t *)"F", 1); // Done Programming
+        }
+        DLOG("XSVF Done. %d\r\n", wjob->seq);
+      break;
+      case XSVF_Q:
+        DLOG("XSVF Streaming....\r\n");
+        /* the stream job carries no data, its buffer takes the scans longer than the ring */
+        if (stream_xsvf(&stream, wjob->buf, sizeof(wjob->buf), TIME_MS2I(XSVF_STREAM_TIMEOUT)) == 0){
+          status = JOB_FAILED;
+          /* an abort comes from a checksum error which was already answered */
+          if (!stream.aborted) job_answer(wjob, (const uint8_t *)"X", 1); // Programming Error or Timeout
+        }
+        else{
+          job_answer(wjob, (const uint8_t *)"F", 1); // Done Programming
+        }
+        ring_abort(&stream); // release the receiver if it waits for space
+        streaming = false;
+        DLOG("XSVF Stream done.\r\n");
+      break;
+      case CLOCK_DA:
+        hz = xsvf_autotune(wjob->buf[0] != 0, &idcode);
+        DLOG("TCK tuned: IDCODE %08X, %d Hz\r\n", idcode, hz);
+        put_be32(&reply[0], idcode);
+        put_be32(&reply[4], hz);
+        reply[8] = 0;
+        for (i=0; i<8; i++) reply[8] += reply[i];
+        /* v2 frames bring their own check */
+        job_answer(wjob, reply, wjob->framed ? 8 : 9);
       break;
       default:
-        chprintf(dbg, "Unknown state %d\r\n", msg);    
+        DLOG("Unknown job %d\r\n", wjob->type);
+        status = JOB_FAILED;
       break;
     }
-    chThdSleepMilliseconds(100);
+    jobq_done(wjob, status);
+    /* the target is in an unknown state, don't play what was queued behind */
+    if (status == JOB_FAILED){
+      DLOG("Skipped %d queued jobs.\r\n", jobq_flush());
+    }
+    chMtxUnlock(&port_mtx);
+  }
+}
+
+/*
+ * Bulk receive of a payload run: the bytes go straight from the USB input
+ * queue into buf and are added to the checksum in one pass, so only the
+ * headers go through the state machine byte by byte.
+ * Returns false if the host stopped sending before n bytes arrived.
+ */
+static bool read_payload(uint8_t *buf, size_t n, uint8_t *cs){
+  size_t i, got;
+  uint8_t sum = *cs;
+
+  got = chnReadTimeout(&OSTRICHPORT, buf, n, TIME_MS2I(500));
+  for (i=0; i<got; i++){
+    sum += buf[i];
+  }
+  *cs = sum;
+  return got == n;
+}
+
+/* Receives and checksums a payload run which has no place to go. */
+static bool skip_payload(size_t n, uint8_t *cs){
+  size_t k;
+  while (n){
+    k = (n > sizeof(buffers.tbuf1)) ? sizeof(buffers.tbuf1) : n;
+    if (!read_payload(buffers.tbuf1, k, cs)) return false;
+    n -= k;
+  }
+  return true;
+}
+
+/* Receives a 'Q' payload straight into the free part of the stream ring. */
+static bool stream_payload(size_t n, uint8_t *cs){
+  uint8_t *p;
+  uint32_t k;
+  while (n){
+    /* blocks while the player is busy, drops the rest once it has stopped */
+    if (!ring_wait_space(&stream, 1, TIME_INFINITE)) return skip_payload(n, cs);
+    p = ring_write_ptr(&stream, &k);
+    if (k > n) k = n;
+    if (!read_payload(p, k, cs)) return false;
+    ring_commit(&stream, k);
+    n -= k;
+  }
+  return true;
+}
+
+/* Starts the player on the stream ring, unless it already plays a stream. */
+static void stream_start(bool framed, uint16_t tag){
+  XSVF_JOB_ST *sjob;
+
+  if (streaming) return;
+  /* the player is idle, so the ring is ours to reset */
+  ring_reset(&stream);
+  streaming = true;
+  /* the stream job carries no data, the ring does */
+  sjob = jobq_take(TIME_INFINITE);
+  sjob->type = XSVF_Q;
+  sjob->framed = framed;
+  sjob->tag = tag;
+  jobq_submit(sjob);
+}
+
+/*
+ * Ostrich v2 (frame.h)
+ * The payload takes the same way as with v1, only the framing differs:
+ * COBS decoding and the CRC run while the bytes are read in.
+ */
+static size_t frame_read(uint8_t *buf, size_t n){
+  return chnReadTimeout(&OSTRICHPORT, buf, n, TIME_MS2I(500));
+}
+
+/* Receives a 'Q' payload straight into the free part of the stream ring. */
+static bool frame_stream(FRAME_RX_ST *rx, size_t n){
+  uint8_t *p;
+  uint32_t k;
+  while (n){
+    /* blocks while the player is busy, drops the rest once it has stopped */
+    if (!ring_wait_space(&stream, 1, TIME_INFINITE)) return frame_rx_drain(rx, n);
+    p = ring_write_ptr(&stream, &k);
+    if (k > n) k = n;
+    if (!frame_rx_get(rx, p, k)) return false;
+    ring_commit(&stream, k);
+    n -= k;
+  }
+  return true;
+}
+
+/*
+ * Header of an 'X' frame: true if its chunk goes into a job buffer.
+ * With the window open only the next chunk in sequence does, the others
+ * are only checked and answered. A window which waited XSVF_STREAM_TIMEOUT
+ * for its next frame belongs to an abandoned upload and is closed.
+ */
+static bool window_take(uint16_t seq){
+  if (win.open){
+    if (chTimeDiffX(win_last, chVTGetSystemTime()) > TIME_MS2I(XSVF_STREAM_TIMEOUT)){
+      win.open = 0;
+      return true;
+    }
+    return !win.failed && (seq == win.next);
+  }
+  return true;
+}
+
+/* A good 'X' frame which was not queued: a repeat, a gap or after a failure. */
+static frame_status_t window_check(uint16_t *seq){
+  if (!win.open) return FRAME_REFUSED;
+  if (win.failed) return FRAME_FAILED;
+  if ((int16_t)(*seq - win.next) < 0){
+    /* queued before but the ACK got lost, ACK it again */
+    *seq = win.next - 1;
+    win.repeats++;
+    return FRAME_OK;
+  }
+  return (*seq == win.next) ? FRAME_REFUSED : FRAME_GAP;
+}
+
+/*
+ * 'D' payloads: 'W' f3 f2 f1 f0, 'R' or 'A' f, same meaning as with v1.
+ * 'P' i f: entry i of the profile record (xsvf_prof.h), as the whole
+ * record doesn't fit into a frame. f=1 clears the profile afterwards.
+ * Returns the length of the answer in reply, -1 if the command is unknown.
+ */
+static int16_t frame_clock(uint16_t seq, const uint8_t *p, uint16_t len, uint8_t *reply){
+  XSVF_TCK_ST tck;
+  XSVF_JOB_ST *cjob;
+
+  if ((len >= 5) && (p[0] == 'W')){
+    xsvf_set_tck(get_be32(&p[1]), &tck);
+    DLOG("TCK: %d Hz requested, %d Hz, engine %d Hz\r\n", tck.request, tck.tck, tck.engine);
+    reply[0] = 'O';
+    return 1;
+  }
+  if ((len >= 1) && (p[0] == 'R')){
+    xsvf_get_tck(&tck);
+    put_be32(&reply[0], tck.request);
+    put_be32(&reply[4], tck.tck);
+    reply[8] = (uint8_t)(tck.engine / 1000 >> 16);
+    reply[9] = (uint8_t)(tck.engine / 1000 >> 8);
+    reply[10] = (uint8_t)(tck.engine / 1000);
+    return 11;
+  }
+  if ((len >= 1) && (p[0] == 'A')){
+    /* answered by the worker with an event frame */
+    cjob = jobq_take(TIME_INFINITE);
+    cjob->type = CLOCK_DA;
+    cjob->buf[0] = (len >= 2) ? p[1] : 0;
+    cjob->size = 1;
+    cjob->framed = 1;
+    cjob->tag = seq;
+    jobq_submit(cjob);
+    return 0;
+  }
+  if ((len >= 2) && (p[0] == 'P')){
+    if (!prof_entry(p[1], reply)) return -1;
+    if ((len >= 3) && p[2]) prof_clear();
+    return PROF_ENTRY_SIZE;
   }
+  return -1;
 }
 
-static THD_WORKING_AREA(waCharacterInputThread, 256);
+/*
+ * Entered with the leading delimiter of a frame. A good frame is answered
+ * with FRAME_ACK and the v1 answer as payload, anything else with FRAME_NAK
+ * and the reason. A bad 'X' chunk is not queued, a bad 'Q' chunk stops the
+ * stream. After a broken frame the receiver skips to the next delimiter.
+ */
+static void frame_receive(void){
+  FRAME_RX_ST rx;
+  uint8_t head[FRAME_HEAD], reply[FRAME_REPLY_MAX], type;
+  uint16_t seq, len;
+  int16_t n;
+  frame_status_t res;
+  XSVF_JOB_ST *fjob;
+
+  do {
+    frame_rx_start(&rx, frame_read);
+    fjob = NULL;
+    type = 0;
+    seq = 0;
+    len = 0;
+    if (frame_rx_get(&rx, head, FRAME_HEAD)){
+      type = head[0];
+      seq = ((uint16_t)head[1] << 8) | head[2];
+      len = ((uint16_t)head[3] << 8) | head[4];
+      switch (type){
+      case 'X':
+        /* waits while all buffers are queued or playing */
+        fjob = ((len <= XSVF_JOB_SIZE) && window_take(seq)) ? jobq_take(TIME_INFINITE) : NULL;
+        if (fjob) frame_rx_get(&rx, fjob->buf, len);
+        else frame_rx_drain(&rx, len); // oversized chunks are dropped
+        break;
+      case 'Q':
+        stream_start(true, seq);
+        if (!frame_stream(&rx, len)) ring_abort(&stream); // the stream lost bytes
+        break;
+      case 'D':
+      case 'V':
+        if (len <= sizeof(buffers.tbuf1)) frame_rx_get(&rx, buffers.tbuf1, len);
+        else frame_rx_drain(&rx, len);
+        break;
+      default:
+        frame_rx_drain(&rx, len);
+        break;
+      }
+    }
+    res = frame_rx_finish(&rx);
+    n = 0;
+    if (res == FRAME_OK){
+      switch (type){
+      case 'X':
+        if (fjob){
+          fjob->type = XSVF_X;
+          fjob->size = len;
+          fjob->framed = 1;
+          fjob->tag = seq;
+          jobq_submit(fjob);
+          fjob = NULL;
+          if (win.open){
+            /* the ACK covers all chunks up to seq */
+            win.next++;
+            win.queued++;
+            win_nak = false;
+          }
+          reply[n++] = 'Y'; // queued
+        }
+        else{
+          res = window_check(&seq);
+          if (res == FRAME_OK) reply[n++] = 'Y';
+        }
+        break;
+      case FRAME_START:
+        win.open = 1;
+        win.failed = 0;
+        win.next = seq + 1;
+        win_nak = false;
+        reply[n++] = OSTRICH_WINDOW;
+        break;
+      case 'Q':
+        reply[n++] = 'Y'; // the player reports on its own
+        break;
+      case 'D':
+        n = frame_clock(seq, buffers.tbuf1, len, reply);
+        if (n < 0) res = FRAME_REFUSED;
+        break;
+      case 'V':
+        reply[n++] = VMAJOR;
+        reply[n++] = VMINOR;
+        reply[n++] = 'U';
+        break;
+      default:
+        res = FRAME_REFUSED;
+        break;
+      }
+    }
+    else if (type == 'Q'){
+      ring_abort(&stream); // stop the player, the data is corrupt
+    }
+    if (fjob) jobq_discard(fjob);
+    if (res == FRAME_OK){
+      frame_send(FRAME_ACK, seq, reply, n);
+    }
+    else if (win.open && (res != FRAME_REFUSED) && (res != FRAME_FAILED)){
+      /* go back to the first missing chunk, the NAK of a gap is sent once */
+      if (rx.count && ((res != FRAME_GAP) || !win_nak)){
+        reply[0] = res;
+        frame_send(FRAME_NAK, win.next, reply, 1);
+        win_nak = true;
+        win.naks++;
+        DLOG("Frame %d refused: %d, missing %d\r\n", seq, res, win.next);
+      }
+    }
+    else if (rx.count){
+      /* seq is only a hint when the frame is broken */
+      reply[0] = res;
+      frame_send(FRAME_NAK, seq, reply, 1);
+      DLOG("Frame %d refused: %d\r\n", seq, res);
+    }
+    if (rx.status != FRAME_TIMEOUT) frame_rx_resync(&rx);
+    win_last = chVTGetSystemTime();
+    /* a delimiter in place of a code byte already starts the next frame */
+  } while ((rx.status == FRAME_CUT) && rx.sync);
+}
+
+static THD_WORKING_AREA(waCharacterInputThread, 512);
 static THD_FUNCTION(CharacterInputThread, arg) {
   uint8_t c;
   
-  static uint16_t cntdwn, count;
-  uint16_t i;
+  static uint16_t count;
+  uint16_t i, k;
+  uint32_t total;
   int32_t address;
   static uint8_t bankemv=0, bankemp=0, bankrw=0, bank;
   static uint8_t btemp;
@@ -278,7 +684,8 @@ static THD_FUNCTION(CharacterInputThread, arg) {
   uint8_t checksum;
   systime_t start, end;
   static uint8_t cs, temp;
-  static uint16_t zoff;
+  static XSVF_TCK_ST tck;
+  bool ok;
   (void)arg;
   while (true){
 #ifdef OSTRICHUSB
@@ -292,7 +699,6 @@ static THD_FUNCTION(CharacterInputThread, arg) {
       if (start > end){
         state = IDLE;
       }
-      end = chTimeAddX(start, TIME_MS2I(500));
       //sdAsynchronousRead(&OSTRICHPORT, (uint8_t *)&c, 1);
       if (state == IDLE){
         debug_print_state("------------ State0: ------------ ", state);
@@ -301,12 +707,15 @@ static THD_FUNCTION(CharacterInputThread, arg) {
       switch (state){
       case IDLE:
         cs = c;
-        buffers.bsize1 = 0;
-        buffers.bsize2 = 0;
         buffers.bufp = &buffers.tbuf1[0];
         //end = chTimeAddX(chVTGetSystemTimeX(), TIME_MS2I(5));
         //chprintf(dbg, "Checksum 0 is %x\r\n", cs);
         switch (c){
+        case 0x00:
+          /* leading delimiter of an Ostrich v2 frame */
+          frame_receive();
+          state = IDLE;
+          break;
         case 'V':
           state = VERSION;
           debug_print_state("V Header Start: ", state);
@@ -351,6 +760,10 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           state = XSVF_X;
           debug_print_state("X Header Start: ", state);
           break;
+        case 'Q':
+          state = XSVF_Q;
+          debug_print_state("Q Header Start: ", state);
+          break;
         default:
           state = IDLE;
           break;
@@ -361,51 +774,87 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           cs += c;
           state = XSVF_Xn;
           debug_print_state("State1: ", state);
-          cntdwn = 0;
           count = (uint16_t)c * 256;
           //count = (c)?(uint16_t)c:256;
           break;
         case XSVF_Xn:
           cs += c;
-          state = XSVF_Xnn;
+          state = XSVF_XnCs;
           debug_print_state("State2: ", state);
           count += (uint16_t)c;
-          //if (count == 0) count = 65536;
-          break;
-        case XSVF_Xnn:
-          cs += c;
-          buffers.bufp[cntdwn++] = c;
-          if (cntdwn == count){
-            state = XSVF_XnCs;
-            debug_print_state("State3: ", state);
-          }          
+          /* waits while all buffers are queued or playing */
+          job = (count <= XSVF_JOB_SIZE) ? jobq_take(TIME_INFINITE) : NULL;
+          if (job){
+            ok = read_payload(job->buf, count, &cs);
+          }
+          else{
+            ok = skip_payload(count, &cs); // oversized chunks are dropped
+          }
+          if (!ok){
+            if (job) jobq_discard(job);
+            job = NULL;
+            state = IDLE;
+            DLOG("Timeout\r\n");
+          }
           break;
         case XSVF_XnCs:
           state = IDLE;
           debug_print_state("State4: ", state);
-          if (c == cs){
-            buffers.bsize1 = count; // size of data in buffer
+          if ((c == cs) && job){
+            job->type = XSVF_X;
+            job->size = count; // size of data in buffer
 
             //if (DEBUGLEVEL >= 1){
-            //  chprintf(dbg, "XSVF (C): cnt: %03d, data: %02X, %02X, %02X, %02X\r\n", count, tbuf1[0], tbuf1[1], tbuf1[2], tbuf1[3]);
+            //  chprintf(dbg, "XSVF (C): cnt: %03d, data: %02X, %02X, %02X, %02X\r\n", count, job->buf[0], job->buf[1], job->buf[2], job->buf[3]);
             //}
             chprintf(ost, "Y"); // Checksum OK.
-            chprintf(dbg, "Wake Working Trhread up.\r\n");
-            chThdResume(&worktp, XSVF_X);
-            chprintf(dbg, "Back.\r\n");
-            //if (write_xsvf(count, buffers.bufp) == 0) chprintf(ost, "X"); // Checksum or Programming Error
+            jobq_submit(job);
           }
           else{
+            if (job) jobq_discard(job);
             chprintf(ost, "X"); // Checksum or Programming Error
-            chprintf(dbg, "Checksum ERROR\r\n");
+            DLOG("Checksum ERROR\r\n");
           }
+          job = NULL;
           break;          
+        //#################### XSVF STREAM #######################
+        // Same framing as 'X', but the data goes straight into the
+        // stream ring and is played while the rest is still arriving.
+        case XSVF_Q:
+          cs += c;
+          state = XSVF_Qn;
+          debug_print_state("State1: ", state);
+          count = (uint16_t)c * 256;
+          break;
+        case XSVF_Qn:
+          cs += c;
+          state = XSVF_QnCs;
+          debug_print_state("State2: ", state);
+          count += (uint16_t)c;
+          stream_start(false, 0);
+          if (!stream_payload(count, &cs)){
+            ring_abort(&stream); // the stream lost bytes, stop the player
+            state = IDLE;
+            DLOG("Timeout\r\n");
+          }
+          break;
+        case XSVF_QnCs:
+          state = IDLE;
+          debug_print_state("State4: ", state);
+          if (c == cs){
+            chprintf(ost, "Y"); // Checksum OK, the player reports on its own
+          }
+          else{
+            ring_abort(&stream); // stop the player, the data is corrupt
+            chprintf(ost, "X"); // Checksum Error
+            DLOG("Checksum ERROR\r\n");
+          }
+          break;
         //####################### WRITE ##########################
         case WRITE:
           cs += c;
           state = WRITE_nM;
           debug_print_state("State2: ", state);
-          cntdwn = 0;
           count = 256;
           if (c) count = (uint16_t)c;
           //chprintf(dbg, "Count: %u\r\n", count);
@@ -418,24 +867,13 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           address =(uint16_t)c;
           address *= 256;
           break;
-        case WRITE_nML:  //18
+        case WRITE_nML:  //18  Here are the Bytes coming
           cs += c;
-          state = WRITE_nMLB;
+          state = WRITE_nMLCs;
           debug_print_state("State2: ", state);
           address += c;
           //chprintf(dbg, "Address: %i\r\n", address);
-          break;
-        case WRITE_nMLB:  //19 Here are the Bytes coming
-          cs += c;
-          //chprintf(dbg, "Countdown1: %i\r\n", cntdwn);
-          buffers.bufp[cntdwn++] = c;
-          //chprintf(dbg, "Countdown2: %u\r\n", cntdwn);
-
-          //chprintf(dbg, "Char: %x\r\n", c);
-          if (cntdwn == count){
-            state = WRITE_nMLCs;
-            debug_print_state("State2: ", state);
-          }
+          if (!read_payload(buffers.bufp, count, &cs)) state = IDLE;
           break;
         case WRITE_nMLCs:  //20
           state = IDLE;
@@ -446,7 +884,7 @@ static THD_FUNCTION(CharacterInputThread, arg) {
             checksum = 0;
             address += 0x10000*bankrw;
             if (DEBUGLEVEL >= 1){
-              chprintf(dbg, "Bulk Write (ML): 0x%6X, cnt: %03d, data: 0x%02X\r\n", address, count, buffers.bufp[0]);
+              DLOG("Bulk Write (ML): 0x%6X, cnt: %03d, data: 0x%02X\r\n", address, count, buffers.bufp[0]);
             }
             //write_block(address, count, buffers.bufp, 0);
             //streamWrite(ost, (const unsigned char *)buffer, count);
@@ -458,7 +896,7 @@ static THD_FUNCTION(CharacterInputThread, arg) {
             chprintf(ost, "O");
           }
           else{
-            chprintf(dbg, "Checksum ERROR\r\n");
+            DLOG("Checksum ERROR\r\n");
           }
           break;
         //####################### READ ##########################
@@ -490,19 +928,18 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           debug_print_val1("Checksum: ", cs);
           if (c == cs){
             if (DEBUGLEVEL >= 1){
-              chprintf(dbg, "Read (R): Addr.: %6X, count: 0x%04x\r\n", address+0x10000*bankrw, count);
+              DLOG("Read (R): Addr.: %6X, count: 0x%04x\r\n", address+0x10000*bankrw, count);
             }
-            //streamWrite(ost, (const unsigned char *)buffer, count);
             checksum = 0;
             //read_block(address+0x10000*bankrw, count, buffers.bufp, 0);
             for (i=0; i<count; i++){
               checksum += buffers.bufp[i];
-              streamPut(ost, buffers.bufp[i]);
             }
+            txq_write(buffers.bufp, count);
             streamPut(ost, checksum);
           }
           else{
-            chprintf(dbg, "Checksum ERROR\r\n");
+            DLOG("Checksum ERROR\r\n");
           }
             break;
           //####################### BULK  #########################
@@ -540,26 +977,17 @@ static THD_FUNCTION(CharacterInputThread, arg) {
             bank = c;
             //chprintf(dbg, "Bank: %u\r\n", c);
           break;
-          case BULK_ZWnBM:  //32
+          case BULK_ZWnBM:  //32  Here are the Bytes coming
             cs += c;
-            state = BULK_ZWnBMB;
+            state = BULK_ZWnBMBCs;
             debug_print_state("State2: ", state);
             address = 0;
             address += (uint16_t)c;
             address *= 256;
             address += 0x10000*bank;
-            zoff = 0;
             //chprintf(dbg, "Address: %08x\r\n", address);
+            if (!read_payload(buffers.bufp, count, &cs)) state = IDLE;
           break;
-          case BULK_ZWnBMB: //33  Here are the Bytes coming
-            cs += c;
-            buffers.bufp[zoff++] = c;
-            //chprintf(dbg, "%02x, %d\r\n", c, zoff);
-            if (zoff == count){
-              state = BULK_ZWnBMBCs;
-              debug_print_state("State2: ", state);
-            }
-            break;
           case BULK_ZWnBMBCs:  //34
             state = IDLE;
             debug_print_state("Got Checksum: ", state);
@@ -571,7 +999,7 @@ static THD_FUNCTION(CharacterInputThread, arg) {
               //write_block(address, count, buffers.bufp, 0);
               chprintf(ost, "O");            }
             else{
-              chprintf(dbg, "Checksum ERROR\r\n");
+              DLOG("Checksum ERROR\r\n");
             }
             break;
           //####################### BULK READ #####################
@@ -624,26 +1052,25 @@ static THD_FUNCTION(CharacterInputThread, arg) {
 // 1            }
             if (c == cs){
               if (DEBUGLEVEL >= 1){
-                chprintf(dbg, "Bulk Read (ZR): Addr.: %6X, blocks: 0x%04x\r\n", address, count);
+                DLOG("Bulk Read (ZR): Addr.: %6X, blocks: 0x%04x\r\n", address, count);
               }
-              //checksum = read_single_byte(address++, 0);
               checksum = 0;
-              streamPut(ost, checksum);
-              count *= 256;
-              count --;
-
-              while (count){ //Blocks of 256 Bytes
-                //buffers.bufp[0] = read_next_byte();
-                buffers.bufp[0] = 0;
-                address++;
-                checksum += buffers.bufp[0];
-                streamPut(ost, buffers.bufp[0]);
-                count--;
+              total = (uint32_t)count * 256;
+              while (total){ //Blocks of 256 Bytes, each goes out in one piece
+                k = (total > sizeof(buffers.tbuf1)) ? sizeof(buffers.tbuf1) : total;
+                for (i=0; i<k; i++){
+                  //buffers.bufp[i] = read_next_byte();
+                  buffers.bufp[i] = 0;
+                  checksum += buffers.bufp[i];
+                }
+                address += k;
+                txq_write(buffers.bufp, k);
+                total -= k;
               }
               streamPut(ost, checksum);
             }
             else{
-              chprintf(dbg, "Checksum ERROR\r\n");
+              DLOG("Checksum ERROR\r\n");
             }
             break;
       //####################### BANK ##########################
@@ -690,7 +1117,7 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           streamPut(ost, bankrw);
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
       case BANK_BRn:
@@ -702,15 +1129,15 @@ static THD_FUNCTION(CharacterInputThread, arg) {
             bankrw = btemp;
             chprintf(ost, "O");
             if (DEBUGLEVEL >= 1){
-              chprintf(dbg, "Changed RW Bank to %i\r\n", bankrw);
+              DLOG("Changed RW Bank to %i\r\n", bankrw);
             }
           }
           else{
-            chprintf(dbg, "Bank > 8 ERROR\r\n");
+            DLOG("Bank > 8 ERROR\r\n");
           }
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
         //---------------------------------------------------------
@@ -731,11 +1158,11 @@ static THD_FUNCTION(CharacterInputThread, arg) {
             //chprintf(dbg, "Changed Persistent Bank to %i\r\n", bankemp);
           }
           else{
-            chprintf(dbg, "Bank > 8 ERROR\r\n");
+            DLOG("Bank > 8 ERROR\r\n");
           }
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
         //---------------------------------------------------------
@@ -764,7 +1191,7 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           streamPut(ost, bankemv);
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
       case BANK_BES:
@@ -776,7 +1203,7 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           streamPut(ost, bankemp);
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
       case BANK_BEn:
@@ -789,11 +1216,11 @@ static THD_FUNCTION(CharacterInputThread, arg) {
             //chprintf(dbg, "Changed Volatile Bank to %i\r\n", bankemv);
           }
           else{
-            chprintf(dbg, "Bank > 8 ERROR\r\n");
+            DLOG("Bank > 8 ERROR\r\n");
           }
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
       //####################### VERSION ##########################
@@ -821,14 +1248,13 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           // Get Checksum of Serial Number
           temp=0;
           for (i=0;i<sizeof(serial);i++){
-            streamPut(ost, serial[i]);
             temp += serial[i];
           }
-          //streamWrite(ost, (const unsigned char *)serial, 9);
+          streamWrite(ost, serial, sizeof(serial));
           streamPut(ost, temp);
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
         //####################### BAUD ##########################
@@ -845,24 +1271,16 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           chprintf(ost, "O");
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
       //####################### CONFIG ##########################
-      case CONFIG_C:
+      case CONFIG_C: //  Here are the Bytes coming
         cs += c;
-        state = CONFIG_Cn;
+        state = CONFIG_CnCs;
         count = (uint16_t)c;
-        cntdwn = 0;
         debug_print_val1("Count: ", count);
-        break;
-      case CONFIG_Cn: //  Here are the Bytes coming
-        cs += c;
-        buffers.bufp[cntdwn++] = c;
-        if (cntdwn == count){
-          debug_print_state("State2: ", state);
-          state = CONFIG_CnCs;
-        }
+        if (!read_payload(buffers.bufp, count, &cs)) state = IDLE;
         break;
       case CONFIG_CnCs:
         debug_print_state("State3: ", state);
@@ -875,7 +1293,7 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           chprintf(ost, "O");
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
       //####################### CLOCK ##########################
@@ -890,25 +1308,25 @@ static THD_FUNCTION(CharacterInputThread, arg) {
             debug_print_state("Got Header: ", state);
             state = CLOCK_DW;
             break;
+          case 'A':
+            debug_print_state("Got Header: ", state);
+            state = CLOCK_DA;
+            break;
+          case 'P':
+            debug_print_state("Got Header: ", state);
+            state = CLOCK_DP;
+            break;
           default:
             state = UNHANDLED;
             break;
         }
         break;
-      case CLOCK_DW:
+      case CLOCK_DW: //  Here are the Bytes coming
         cs += c;
-        state = CLOCK_DWn;
+        state = CLOCK_DWnCs;
         count = (uint16_t)c;
-        cntdwn = 0;
         debug_print_val1("Count: ", count);
-        break;
-      case CLOCK_DWn: //  Here are the Bytes coming
-        cs += c;
-        buffers.bufp[cntdwn++] = c;
-        if (cntdwn == count){
-          debug_print_state("State2: ", state);
-          state = CLOCK_DWnCs;
-        }
+        if (!read_payload(buffers.bufp, count, &cs)) state = IDLE;
         break;
 //      case CLOCK_DR:
 //        cs += c;
@@ -922,47 +1340,97 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           if (DEBUGLEVEL >= 1){
             chprintf(dbg, "Clock (C): %02d, %02X, %02X, %02X, %02X, %02X, %02X, %02X, %02X, %02X, %02X\r\n", buffers.bufp[0], buffers.bufp[1], buffers.bufp[2], buffers.bufp[3], buffers.bufp[4], buffers.bufp[5], buffers.bufp[6], buffers.bufp[7], buffers.bufp[8], buffers.bufp[9], buffers.bufp[10]);
           }
-          //write_clock(buffers.bufp);
-          chprintf(ost, "O");
+          /* B1..B4: TCK rate in Hz, MSB first, 0 for the power-up default */
+          if (count >= 4){
+            xsvf_set_tck(get_be32(buffers.bufp), &tck);
+            DLOG("TCK: %d Hz requested, %d Hz, engine %d Hz\r\n", tck.request, tck.tck, tck.engine);
+            chprintf(ost, "O");
+          }
+          else{
+            DLOG("Clock: %d bytes, need 4\r\n", count);
+          }
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
       case CLOCK_DRCs:
         debug_print_state("State3: ", state);
         state = IDLE;
         if (c == cs){
-          //count = read_clock(buffers.bufp);
-          count = 0;
-          // Get Checksum of Serial Number
+          /* requested Hz, kernel Hz (4 bytes each) and engine kHz (3 bytes), MSB first */
+          xsvf_get_tck(&tck);
+          put_be32(&buffers.bufp[0], tck.request);
+          put_be32(&buffers.bufp[4], tck.tck);
+          buffers.bufp[8] = (uint8_t)(tck.engine / 1000 >> 16);
+          buffers.bufp[9] = (uint8_t)(tck.engine / 1000 >> 8);
+          buffers.bufp[10] = (uint8_t)(tck.engine / 1000);
+          count = 11;
           temp=0;
           for (i=0;i<count;i++){
-            streamPut(ost, buffers.bufp[i]);
             temp += buffers.bufp[i];
           }
-          streamPut(ost, temp);
+          buffers.bufp[count] = temp;
+          streamWrite(ost, buffers.bufp, count + 1);
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
-      //####################### PINS ##########################
-      case PINS_C:
+      case CLOCK_DA: // force flag
         cs += c;
-        state = PINS_Cn;
-        count = (uint16_t)c;
-        cntdwn = 0;
-        debug_print_val1("Count: ", count);
+        temp = c;
+        state = CLOCK_DAfCs;
+        break;
+      case CLOCK_DAfCs:
+        debug_print_state("State3: ", state);
+        state = IDLE;
+        if (c == cs){
+          /* the sweep drives the JTAG port, so it queues up behind the
+             chunks, the worker sends the answer */
+          job = jobq_take(TIME_INFINITE);
+          job->type = CLOCK_DA;
+          job->buf[0] = temp;
+          job->size = 1;
+          jobq_submit(job);
+          job = NULL;
+        }
+        else{
+          DLOG("Checksum ERROR\r\n");
+        }
         break;
-      case PINS_Cn: //  Here are the Bytes coming
+      case CLOCK_DP: // clear flag
         cs += c;
-        buffers.bufp[cntdwn++] = c;
-        if (cntdwn == count){
-          debug_print_state("State2: ", state);
-          state = PINS_CnCs;
+        temp = c;
+        state = CLOCK_DPfCs;
+        break;
+      case CLOCK_DPfCs:
+        debug_print_state("State3: ", state);
+        state = IDLE;
+        if (c == cs){
+          /* the profile record (xsvf_prof.h) and its checksum in one write */
+          prof_buf[PROF_RECORD_SIZE] = 0;
+          for (i=0; i<=PROF_ENTRIES; i++){
+            prof_entry(i, &prof_buf[i * PROF_ENTRY_SIZE]);
+          }
+          for (i=0; i<PROF_RECORD_SIZE; i++){
+            prof_buf[PROF_RECORD_SIZE] += prof_buf[i];
+          }
+          if (temp) prof_clear();
+          txq_write(prof_buf, sizeof(prof_buf));
+        }
+        else{
+          DLOG("Checksum ERROR\r\n");
         }
         break;
+      //####################### PINS ##########################
+      case PINS_C: //  Here are the Bytes coming
+        cs += c;
+        state = PINS_CnCs;
+        count = (uint16_t)c;
+        debug_print_val1("Count: ", count);
+        if (!read_payload(buffers.bufp, count, &cs)) state = IDLE;
+        break;
       case PINS_CnCs:
         debug_print_state("State3: ", state);
         state = IDLE;
@@ -974,23 +1442,65 @@ static THD_FUNCTION(CharacterInputThread, arg) {
           chprintf(ost, "O");
         }
         else{
-          chprintf(dbg, "Checksum ERROR\r\n");
+          DLOG("Checksum ERROR\r\n");
         }
         break;
 
       case UNHANDLED:
         state = IDLE;
         break;
+      default: // payload states, the payload is read in one go
+        state = IDLE;
+        break;
       }
+      /* the timeout counts from the end of the (possibly long) processing */
+      end = chTimeAddX(chVTGetSystemTime(), TIME_MS2I(500));
     }
     else{
       chThdSleepMilliseconds(100);
     }
   }
 }
+/* Window of the v2 'X' frames, for the shell. */
+void ostrich_get_window(OSTRICH_WIN_ST *w){
+  *w = win;
+}
+
+/*
+ * The JTAG port for someone else than the worker, false while a job is
+ * queued or playing or a stream is open. A job which comes in meanwhile
+ * waits for ostrich_port_release().
+ */
+bool ostrich_port_claim(void){
+  JOBQ_STATS_ST q;
+
+  if (!chMtxTryLock(&port_mtx)) return false;
+  jobq_get_stats(&q);
+  if (streaming || (uint16_t)(q.submitted - q.done - q.failed - q.skipped)){
+    chMtxUnlock(&port_mtx);
+    return false;
+  }
+  return true;
+}
+
+void ostrich_port_release(void){
+  chMtxUnlock(&port_mtx);
+}
+
 void start_ostrich_thread(void){
+  chMtxObjectInit(&port_mtx);
+  crc32_init();
+  txq_start((BaseChannel *)&OSTRICHPORT);
+  jobq_init();
+  ring_init(&stream, stream_buf, sizeof(stream_buf));
+  /*
+   * The worker runs below the receiver: there is no round robin
+   * (CH_CFG_TIME_QUANTUM 0), so at the same priority the receiver would
+   * only get to SDU1 when the worker blocks, and the next chunk couldn't
+   * come in while a scan or a busy wait plays.
+   */
   chThdCreateStatic(waCharacterInputThread, sizeof(waCharacterInputThread), NORMALPRIO, CharacterInputThread, NULL);
-  chThdCreateStatic(waWorkThread, sizeof(waWorkThread), NORMALPRIO, WorkThread, NULL);
+  chThdCreateStatic(waWorkThread, sizeof(waWorkThread), NORMALPRIO - 1, WorkThread, NULL);
 }
 
 
@@ -0,0 +1,158 @@
+/*
+ * ring.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "ring.h"
+
+void ring_init(RING_ST *r, uint8_t *buf, uint32_t size){
+  chDbgAssert((size & (size - 1)) == 0, "ring size not a power of 2");
+  r->buf = buf;
+  r->mask = size - 1;
+  chBSemObjectInit(&r->data, true);
+  chBSemObjectInit(&r->space, true);
+  ring_reset(r);
+}
+
+/* Only call this while neither side is using the ring. */
+void ring_reset(RING_ST *r){
+  r->head = 0;
+  r->tail = 0;
+  r->aborted = false;
+  chBSemReset(&r->data, true);
+  chBSemReset(&r->space, true);
+}
+
+/* Wakes up both sides, any further wait fails until ring_reset(). */
+void ring_abort(RING_ST *r){
+  chSysLock();
+  r->aborted = true;
+  chBSemResetI(&r->data, true);
+  chBSemResetI(&r->space, true);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+uint32_t ring_count(RING_ST *r){
+  return r->head - r->tail;
+}
+
+uint32_t ring_space(RING_ST *r){
+  return r->mask + 1 - (r->head - r->tail);
+}
+
+uint32_t ring_size(RING_ST *r){
+  return r->mask + 1;
+}
+
+/* Producer side: copies as much as fits, returns the number of bytes taken. */
+uint32_t ring_write(RING_ST *r, const uint8_t *data, uint32_t len){
+  uint32_t i, head = r->head;
+  uint32_t n = ring_space(r);
+
+  if (n > len) n = len;
+  for (i=0; i<n; i++){
+    r->buf[(head + i) & r->mask] = data[i];
+  }
+  __DMB(); /* data must be visible before the new head */
+  r->head = head + n;
+  if (n) chBSemSignal(&r->data);
+  return n;
+}
+
+/* Producer side: the free bytes up to the end of the buffer. */
+uint8_t * ring_write_ptr(RING_ST *r, uint32_t *len){
+  uint32_t head = r->head & r->mask;
+  uint32_t n = ring_space(r);
+
+  if (n > r->mask + 1 - head) n = r->mask + 1 - head;
+  *len = n;
+  return &r->buf[head];
+}
+
+/* Producer side: publishes len bytes written through ring_write_ptr(). */
+void ring_commit(RING_ST *r, uint32_t len){
+  __DMB(); /* data must be visible before the new head */
+  r->head += len;
+  if (len) chBSemSignal(&r->data);
+}
+
+/*
+ * Producer side: blocks until there is room for n bytes, false after an
+ * abort. The aborted check and the wait are one under the lock, else an
+ * abort between them would reset the semaphore before anyone waits on it.
+ */
+bool ring_wait_space(RING_ST *r, uint32_t n, sysinterval_t timeout){
+  msg_t msg = MSG_OK;
+
+  chSysLock();
+  while ((ring_space(r) < n) && (msg == MSG_OK)){
+    msg = r->aborted ? MSG_RESET : chBSemWaitTimeoutS(&r->space, timeout);
+  }
+  if (r->aborted) msg = MSG_RESET;
+  chSysUnlock();
+  return msg == MSG_OK;
+}
+
+/* Producer side: blocks while the ring is full. */
+bool ring_put(RING_ST *r, uint8_t c, sysinterval_t timeout){
+  if (!ring_wait_space(r, 1, timeout)) return false;
+  return ring_write(r, &c, 1) == 1;
+}
+
+/* Consumer side: look at a byte without removing it. */
+uint8_t ring_peek(RING_ST *r, uint32_t offset){
+  return r->buf[(r->tail + offset) & r->mask];
+}
+
+/* Consumer side: the bytes up to the end of the buffer, without removing them. */
+const uint8_t * ring_read_ptr(RING_ST *r, uint32_t *len){
+  uint32_t tail = r->tail & r->mask;
+  uint32_t n = ring_count(r);
+
+  if (n > r->mask + 1 - tail) n = r->mask + 1 - tail;
+  *len = n;
+  return &r->buf[tail];
+}
+
+/* Consumer side: where the bytes continue when ring_read_ptr() stops at the wrap. */
+const uint8_t * ring_wrap_ptr(RING_ST *r){
+  return r->buf;
+}
+
+/* Consumer side: removes len bytes which were used through ring_read_ptr(). */
+void ring_skip(RING_ST *r, uint32_t len){
+  __DMB(); /* data must be read before the slot is handed back */
+  r->tail += len;
+  if (len) chBSemSignal(&r->space);
+}
+
+/* Consumer side: removes up to len bytes, returns the number of bytes read. */
+uint32_t ring_read(RING_ST *r, uint8_t *data, uint32_t len){
+  uint32_t i, tail = r->tail;
+  uint32_t n = ring_count(r);
+
+  if (n > len) n = len;
+  for (i=0; i<n; i++){
+    data[i] = r->buf[(tail + i) & r->mask];
+  }
+  __DMB(); /* data must be read before the slot is handed back */
+  r->tail = tail + n;
+  if (n) chBSemSignal(&r->space);
+  return n;
+}
+
+/* Consumer side: blocks until at least n bytes are available, see ring_wait_space(). */
+msg_t ring_wait(RING_ST *r, uint32_t n, sysinterval_t timeout){
+  msg_t msg = MSG_OK;
+
+  chSysLock();
+  while ((ring_count(r) < n) && (msg == MSG_OK)){
+    msg = r->aborted ? MSG_RESET : chBSemWaitTimeoutS(&r->data, timeout);
+  }
+  chSysUnlock();
+  return msg;
+}
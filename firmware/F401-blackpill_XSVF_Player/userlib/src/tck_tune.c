@@ -0,0 +1,118 @@
+/*
+ * tck_tune.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "tck_tune.h"
+
+typedef struct {
+  uint32_t idcode;
+  uint32_t hz;
+} TUNE_CACHE_ST;
+
+static TUNE_CACHE_ST cache[TUNE_CACHE];
+static uint8_t cache_next;
+
+#define BIT(p, i)  (((p)[(i)>>3] >> ((i)&7)) & 1)
+
+/* xorshift32, seed 0 is replaced */
+void tune_pattern(uint8_t *p, uint32_t bits, uint32_t seed){
+  uint32_t i, x = seed ? seed : 0x2545F491;
+
+  for (i=0; i<(bits+7)>>3; i++){
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    p[i] = (uint8_t)x;
+  }
+}
+
+/*
+ * Each device in BYPASS delays TDO by one bit. Returns the delay which
+ * lines tdo up with the pattern, -1 if there is none.
+ */
+int tune_check(const uint8_t *pattern, const uint8_t *tdo, uint32_t bits){
+  uint32_t d, i;
+
+  for (d=1; d<=TUNE_MAX_DELAY; d++){
+    for (i=d; i<bits; i++){
+      if (BIT(tdo, i) != BIT(pattern, i-d)) break;
+    }
+    if (i == bits) return (int)d;
+  }
+  return -1;
+}
+
+/* bit 0 of an IDCODE is always 1, stuck TDO gives all 0 or all 1 */
+bool tune_idcode_valid(uint32_t idcode){
+  return (idcode & 1) && (idcode != 0xFFFFFFFF);
+}
+
+static bool probe_ok(const TUNE_OPS_ST *ops, uint32_t idcode, int *delay, uint32_t step){
+  uint8_t pattern[TUNE_BITS/8], tdo[TUNE_BITS/8];
+  uint32_t i, id;
+  int d;
+
+  for (i=0; i<TUNE_TRIES; i++){
+    tune_pattern(pattern, TUNE_BITS, (step << 8) + i + 1);
+    if (!ops->probe(pattern, tdo, &id) || id != idcode) return false;
+    d = tune_check(pattern, tdo, TUNE_BITS);
+    if (d < 0 || (*delay && d != *delay)) return false;
+    *delay = d;
+  }
+  return true;
+}
+
+/*
+ * Starts at min_hz, which must be safe, and raises the rate by 25% per
+ * step up to max_hz until a probe fails. The highest good rate less
+ * margin percent is set and returned, 0 if the TAP failed at min_hz.
+ */
+uint32_t tune_sweep(const TUNE_OPS_ST *ops, uint32_t min_hz, uint32_t max_hz,
+                    uint32_t margin, uint32_t *idcode){
+  uint8_t pattern[TUNE_BITS/8], tdo[TUNE_BITS/8];
+  uint32_t req = min_hz, hz, good, step = 0;
+  int delay = 0;
+
+  good = ops->set_rate(min_hz);
+  tune_pattern(pattern, TUNE_BITS, 0);
+  if (!ops->probe(pattern, tdo, idcode) || !tune_idcode_valid(*idcode) ||
+      !probe_ok(ops, *idcode, &delay, step)){
+    *idcode = 0;
+    return 0;
+  }
+  while (req < max_hz){
+    req += req / 4;
+    if (req > max_hz) req = max_hz;
+    hz = ops->set_rate(req);
+    if (hz <= good) continue;   /* same setting as the last step */
+    if (!probe_ok(ops, *idcode, &delay, ++step)) break;
+    good = hz;
+  }
+  return ops->set_rate(good - good / 100 * margin);
+}
+
+/* 0 if the IDCODE was not tuned yet */
+uint32_t tune_cache_get(uint32_t idcode){
+  uint32_t i;
+
+  for (i=0; i<TUNE_CACHE; i++){
+    if (cache[i].hz && cache[i].idcode == idcode) return cache[i].hz;
+  }
+  return 0;
+}
+
+void tune_cache_put(uint32_t idcode, uint32_t hz){
+  uint32_t i;
+
+  for (i=0; i<TUNE_CACHE; i++){
+    if (cache[i].hz && cache[i].idcode == idcode) break;
+  }
+  if (i == TUNE_CACHE){
+    i = cache_next;
+    cache_next = (cache_next + 1) % TUNE_CACHE;
+  }
+  cache[i].idcode = idcode;
+  cache[i].hz = hz;
+}
@@ -0,0 +1,153 @@
+/*
+ * txq.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+#include "txq.h"
+
+/*
+ * Single writer of the Ostrich port. The other threads queue their
+ * answers, the TX thread packs all queued short answers into full USB
+ * packets and hands bulk data to the driver as one buffer. Short writes
+ * are copied into the message, bulk writes only pass the pointer and
+ * block until the data is out, so the sender may reuse its buffer.
+ */
+static objects_fifo_t msgs;
+static msg_t msgs_msg[TXQ_MSGS];
+static TXQ_MSG_ST msgs_buf[TXQ_MSGS];
+static BaseChannel *port;
+static uint8_t packet[TXQ_PACKET];
+static uint16_t fill;
+static TXQ_STATS_ST stats;
+
+static void tx_flush(void){
+  if (fill){
+    chnWriteTimeout(port, packet, fill, TIME_INFINITE);
+    stats.writes++;
+    stats.bytes += fill;
+    fill = 0;
+  }
+}
+
+static void tx_add(const uint8_t *p, size_t n){
+  size_t k;
+  while (n){
+    k = TXQ_PACKET - fill;
+    if (k > n) k = n;
+    memcpy(&packet[fill], p, k);
+    fill += k;
+    p += k;
+    n -= k;
+    if (fill == TXQ_PACKET) tx_flush();
+  }
+}
+
+static THD_WORKING_AREA(waTxThread, 256);
+static THD_FUNCTION(TxThread, arg){
+  (void)arg;
+  void *obj;
+  TXQ_MSG_ST *m;
+
+  while (true){
+    chFifoReceiveObjectTimeout(&msgs, &obj, TIME_INFINITE);
+    /* everything queued meanwhile goes out in as few packets as possible */
+    do {
+      m = (TXQ_MSG_ST *)obj;
+      stats.msgs++;
+      if (m->p){
+        tx_flush();
+        chnWriteTimeout(port, m->p, m->n, TIME_INFINITE);
+        stats.bulk++;
+        stats.writes++;
+        stats.bytes += m->n;
+        chBSemSignal(m->done);
+      }
+      else{
+        tx_add(m->buf, m->n);
+      }
+      chFifoReturnObject(&msgs, m);
+    } while (chFifoReceiveObjectTimeout(&msgs, &obj, TIME_IMMEDIATE) == MSG_OK);
+    tx_flush();
+  }
+}
+
+/* Queues a copy of p, returns at once unless all messages are in use. */
+void txq_put(const uint8_t *p, size_t n){
+  TXQ_MSG_ST *m;
+  size_t k;
+  while (n){
+    k = (n > TXQ_MSG_SIZE) ? TXQ_MSG_SIZE : n;
+    m = chFifoTakeObjectTimeout(&msgs, TIME_INFINITE);
+    m->p = NULL;
+    m->done = NULL;
+    m->n = k;
+    memcpy(m->buf, p, k);
+    chFifoSendObject(&msgs, m);
+    p += k;
+    n -= k;
+  }
+}
+
+/* Queues p without a copy and waits until it was written. */
+void txq_write(const uint8_t *p, size_t n){
+  TXQ_MSG_ST *m;
+  binary_semaphore_t done;
+
+  if (n == 0) return;
+  chBSemObjectInit(&done, true);
+  m = chFifoTakeObjectTimeout(&msgs, TIME_INFINITE);
+  m->p = p;
+  m->done = &done;
+  m->n = n;
+  chFifoSendObject(&msgs, m);
+  chBSemWait(&done);
+}
+
+void txq_get_stats(TXQ_STATS_ST *s){
+  chSysLock();
+  *s = stats;
+  chSysUnlock();
+}
+
+/* stream interface, so chprintf() and streamPut() take the same way */
+static size_t stream_write(void *ip, const uint8_t *bp, size_t n){
+  (void)ip;
+  txq_put(bp, n);
+  return n;
+}
+
+static size_t stream_read(void *ip, uint8_t *bp, size_t n){
+  (void)ip;
+  (void)bp;
+  (void)n;
+  return 0; // output only, the receiver reads the port itself
+}
+
+static msg_t stream_put(void *ip, uint8_t b){
+  (void)ip;
+  txq_put(&b, 1);
+  return MSG_OK;
+}
+
+static msg_t stream_get(void *ip){
+  (void)ip;
+  return MSG_RESET;
+}
+
+static const struct BaseSequentialStreamVMT vmt = {
+  (size_t)0, stream_write, stream_read, stream_put, stream_get
+};
+
+BaseSequentialStream txq_stream = { &vmt };
+
+void txq_start(BaseChannel *chn){
+  port = chn;
+  fill = 0;
+  memset(&stats, 0, sizeof(stats));
+  chFifoObjectInit(&msgs, sizeof(TXQ_MSG_ST), TXQ_MSGS, msgs_buf, msgs_msg);
+  chThdCreateStatic(waTxThread, sizeof(waTxThread), TXQ_PRIO, TxThread, NULL);
+}
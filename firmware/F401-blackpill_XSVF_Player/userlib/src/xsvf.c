@@ -5,7 +5,10 @@
  *      Author: rob
  */
 
+#include <string.h>
 #include "xsvf.h"
+#include "xsvf_prof.h"
+#include "dlog.h"
 #include "chprintf.h"
 extern BaseSequentialStream *const ost;
 extern BaseSequentialStream *const dbg;
@@ -50,244 +53,351 @@ const uint16_t tms_map[] = {
 	0x7ffd,	/* STATE_UPDATE_IR	*/
 };
 
-uint8_t current_state = 0;
-#define MAX_SIZE 0x20
-
-uint8_t repeat;
-uint32_t sdr_size;
-uint32_t run_test;
-
-uint8_t address_mask[MAX_SIZE];
-uint8_t data_mask[MAX_SIZE];
-uint8_t tdi_value[MAX_SIZE];
-uint8_t tdo_mask[MAX_SIZE];
-uint8_t tdo_expected[MAX_SIZE];
-
-void wait_nops(uint32_t t){
-	uint32_t i;
-	for (i=0; i<t; i++){
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-    	__NOP();
-	}
-}
+/* TMS path between any two states, bits 0..7: TMS LSB first, bits 8..11: length */
+static uint16_t tms_paths[16][16];
 
-void set_port(uint8_t p, uint8_t val){
-	static uint32_t BSRR_TMS, BSRR_TDI;
+/* the player behind write_xsvf() and stream_xsvf() */
+static XSVF_CTX_ST player;
 
-	if (p == TMS && val == 0) BSRR_TMS = (1 << (TMS_Pin+16));
-	if (p == TMS && val == 1) BSRR_TMS = (1 << TMS_Pin);
-	if (p == TDI && val == 0) BSRR_TDI = (1 << (TDI_Pin+16));
-	if (p == TDI && val == 1) BSRR_TDI = (1 << TDI_Pin);
+/* longest fixed size instruction, XWAITSTATE */
+#define INST_HEAD 11
 
-	/* clock TMS and TDI on falling TCK */
-	if (p == TCK) {
-		if (val == 0) {
-			//chprintf(dbg, "Clock Low\r\n");
-			XSVF_GPIO_BSRR = BSRR_TMS | BSRR_TDI | (1 << (TCK_Pin+16));
-		} else {
-			//chprintf(dbg, "Clock Hi\r\n");
-			XSVF_GPIO_BSRR = (1 << TCK_Pin);
-		}
-	}
-}
+/* operand bytes shifted per kernel call by scan() */
+#define SCAN_BLOCK MAX_SIZE
 
-void pulse_clock(void){
-	set_port(TCK,0);
-	set_port(TCK,1);
-	wait_nops(4);
-	set_port(TCK,0);
-	wait_nops(4);
-}
-
-
-/* Wait at least the specified number of microsec. */
-void delay(int32_t microsec){
-//	_delay_ms(microsec>>12);
-	//wait_nops();
-	set_port(TCK,0);
-	//chprintf(dbg, "Port set1\r\n");
-	while (--microsec > 0) {
-		wait_nops(4);
-		set_port(TCK,1);
-		//chprintf(dbg, "Port set2\r\n");
-		wait_nops(4);
-		set_port(TCK,0);
-		//chprintf(dbg, "Port set3\r\n");
-	}
-}
+/* scan() result when the shift engine failed */
+#define SCAN_ERROR (-1)
 
-void set_state(uint8_t state){
-	current_state = state;
+/*
+ * A complete instruction, in two pieces if it runs over the end of the
+ * stream ring: the first n bytes at p, the rest at wrap.
+ */
+typedef struct {
+	const uint8_t *p;
+	uint32_t n;
+	const uint8_t *wrap;
+} XSVF_SRC_ST;
+
+/* TCK rate, set by the receiver and applied by the worker between jobs */
+static XSVF_TCK_ST tck;
+static volatile bool tck_pending;
+
+/* end of the last write_xsvf() of a file which goes on, for PROF_IDLE */
+static uint32_t chunk_end;
+static bool in_file;
+
+void set_state(XSVF_CTX_ST *x, uint8_t state){
+	x->current_state = state;
 }
 
-void state_ack(uint8_t tms){
+void state_ack(XSVF_CTX_ST *x, uint8_t tms){
 	if (tms==0) {
-		current_state = tms_transitions[current_state]&0xf;
+		x->current_state = tms_transitions[x->current_state]&0xf;
 	} else {
-		current_state = (tms_transitions[current_state]>>4)&0xf;
+		x->current_state = (tms_transitions[x->current_state]>>4)&0xf;
 	}
 }
 
-void state_step(uint8_t tms){
+void state_step(XSVF_CTX_ST *x, uint8_t tms){
 	set_port(TMS,tms);
 	pulse_clock();
-	state_ack(tms);
+	state_ack(x, tms);
 }
 
-void state_goto(uint8_t state){
+/* Walks tms_map once for every pair of states, state_goto() replays the paths. */
+static void tms_paths_init(void){
+	uint8_t from, to, cur, tms, n;
+	uint16_t bits;
+
+	for (from=0; from<16; from++){
+		for (to=0; to<16; to++){
+			cur = from;
+			bits = 0;
+			n = 0;
+			while (cur != to) {
+				tms = (tms_map[cur]>>to) & 1;
+				bits |= tms << n++;
+				cur = tms ? (tms_transitions[cur]>>4) : (tms_transitions[cur]&0xf);
+			}
+			tms_paths[from][to] = (n << 8) | bits;
+		}
+	}
+}
+
+/* The whole path goes out as one TMS burst. */
+void state_goto(XSVF_CTX_ST *x, uint8_t state){
+	uint32_t t0 = prof_now();
+	uint16_t path;
+
 	//chprintf(dbg, "State Goto %02X\r\n", state);
 	if (state==STATE_TLR) {
-		uint8_t i;
-		for (i=0;i<5;i++) {
-			state_step(1);
-		}
+		/* five times TMS=1 reset the TAP from any state, even an unknown one */
+		jtag_tms(0x1f, 5);
+		x->ir_valid = 0;
+	} else {
+		path = tms_paths[x->current_state][state & 0xf];
+		jtag_tms(path & 0xff, path >> 8);
+	}
+	x->current_state = state & 0xf;
+	prof_add(PROF_STATE_GOTO, t0);
+}
 
+/*
+ * output dataVal onto the TDI ports; store the TDO value returned
+ * Returns false if the engine failed, the TAP state is unknown then.
+ */
+static bool shift(XSVF_CTX_ST *x, int flags, const uint8_t *data, uint8_t *tdo, uint32_t length){
+	if (length == 0) return true;
+#if XSVF_SHIFT_REFERENCE
+	jtag_shift_ref(data, tdo, length, flags&SDR_END);
+#elif XSVF_USE_SPI
+	jtag_spi_shift(data, tdo, length, flags&SDR_END);
+#elif XSVF_USE_WAVE
+	if (!jtag_dma_shift(data, tdo, length, flags&SDR_END)) return false;
+#else
+	if (flags&SDR_END) {
+		if (tdo) jtag_shift_io_exit(data, tdo, length);
+		else jtag_shift_out_exit(data, length);
 	} else {
-		while (current_state != state) {
-			uint8_t tms = (tms_map[current_state]>>state) & 1;
-			state_step(tms);
-		}
+		if (tdo) jtag_shift_io(data, tdo, length);
+		else jtag_shift_out(data, length);
 	}
+#endif
+	/* on the last bit TMS was 1, so we went to the EXIT state */
+	if (flags&SDR_END) state_ack(x, 1);
+	return true;
 }
 
-uint8_t read_tdo(void){
-	return (palReadLine(TDO_PIN) == PAL_HIGH) ? 1 : 0 ;
+static inline uint8_t src_byte(const XSVF_SRC_ST *s, uint32_t i){
+	return (i < s->n) ? s->p[i] : s->wrap[i - s->n];
 }
 
-/* output dataVal onto the TDI ports; store the TDO value returned */
-static void shift(int flags, uint8_t *data, uint8_t *tdo, uint32_t length){
-	int i,j;
-	int n_bytes = BYTES(length);
+/* byte k, counted from the LSB, of the bits long operand at offset off */
+static inline uint8_t op_byte(const XSVF_SRC_ST *s, uint32_t off, uint32_t bits, uint32_t k){
+	return src_byte(s, off + BYTES(bits) - 1 - k);
+}
 
-	for (i=0; i<n_bytes; i++){
-		//chprintf(dbg, "Shift Byte: %02X\r\n", i);
-		uint8_t byte = data[i];
-		uint8_t in = 0;
-		for (j=0;j<8;j++){
-			//chprintf(dbg, "Shift Bit: %02X\r\n", j);
-			/* on the last bit, set TMS to 1 so that we go to the EXIT state */
-			if ((length==1) && (flags&SDR_END)) {
-				set_port(TMS,1);
-				state_ack(1);
-			}
-			if (length>0) {
-				if (tdo) {
-					in |= read_tdo()<<j;
-					//chprintf(dbg, "TDO: %d\r\n", read_tdo());
-				}
-				set_port(TDI, byte&1);
-				byte >>= 1;
+/*
+ * Bytes k..k+3 of the operand as one LSB first word. In the file they are
+ * in big endian order, so the four bytes are loaded at once and swapped.
+ */
+static inline uint32_t op_word(const XSVF_SRC_ST *s, uint32_t off, uint32_t bits, uint32_t k){
+	uint32_t i = off + BYTES(bits) - 4 - k;
+	uint32_t w;
+
+	if (i + 4 <= s->n) {
+		memcpy(&w, &s->p[i], 4);
+	} else if (i >= s->n) {
+		memcpy(&w, &s->wrap[i - s->n], 4);
+	} else {
+		/* across the wrap of the stream ring */
+		return op_byte(s, off, bits, k) | (op_byte(s, off, bits, k + 1) << 8) |
+			(op_byte(s, off, bits, k + 2) << 16) | ((uint32_t)op_byte(s, off, bits, k + 3) << 24);
+	}
+	return __builtin_bswap32(w);
+}
+
+#if (XSVF_VEC_SIZE & 3) != 0
+#error "XSVF_VEC_SIZE must be a multiple of 4"
+#endif
+
+static inline uint8_t vec_byte(const XSVF_VEC_ST *v, uint32_t k){
+	return (k < XSVF_VEC_SIZE) ? v->head[k] : v->fill;
+}
+
+/* bytes k..k+3 as one word, k is a multiple of 4 */
+static inline uint32_t vec_word(const XSVF_VEC_ST *v, uint32_t k){
+	uint32_t w;
+
+	if (k >= XSVF_VEC_SIZE) return v->fill * 0x01010101U;
+	memcpy(&w, &v->head[k], 4);
+	return w;
+}
+
+/* Keeps the bits long operand at offset off, see XSVF_VEC_ST. */
+static void vec_load(XSVF_VEC_ST *v, const XSVF_SRC_ST *s, uint32_t off, uint32_t bits){
+	uint32_t k, bytes = BYTES(bits);
+	uint8_t b, valid;
+
+	memset(v->head, 0, sizeof(v->head));
+	v->fill = 0;
+	v->ok = 1;
+	for (k=0; k<bytes; k++){
+		b = op_byte(s, off, bits, k);
+		if (k < XSVF_VEC_SIZE) {
+			v->head[k] = b;
+		} else if (k == XSVF_VEC_SIZE) {
+			v->fill = b;
+		} else {
+			/* the unused top bits of the last byte don't count */
+			valid = ((k == bytes - 1) && (bits & 7)) ? (1 << (bits & 7)) - 1 : 0xff;
+			if ((b ^ v->fill) & valid) v->ok = 0;
+		}
+	}
+}
+
+/*
+ * Shifts the bits long operand at offset tdi of the instruction straight
+ * out of the input, SCAN_BLOCK bytes at a time. XSVF stores operands MSB
+ * first, so the blocks are taken from the end of the operand, a word at
+ * a time.
+ * With SDR_CHECK, each captured block is compared word by word under the
+ * TDO mask against the operand at offset tdo, or against the expected
+ * value of the last XSDRTDO if tdo is 0. The differences are only
+ * collected, so a passing scan takes no branch for them. Returns 1 on a
+ * mismatch, all bits are shifted anyway, and SCAN_ERROR if the engine
+ * failed, which stops the scan.
+ */
+static int scan(XSVF_CTX_ST *x, int flags, const XSVF_SRC_ST *s, uint32_t tdi, uint32_t tdo, uint32_t bits){
+	uint32_t out[SCAN_BLOCK/4], in[SCAN_BLOCK/4];
+	uint8_t *out8 = (uint8_t *)out, *in8 = (uint8_t *)in;
+	uint32_t k, n, bytes, full, left = bits, done = 0;
+	uint32_t expected, mask, diff = 0;
 
-				pulse_clock();
-				length--;
+	while (left){
+		n = (left > SCAN_BLOCK*8) ? SCAN_BLOCK*8 : left;
+		bytes = BYTES(n);
+		for (k=0; k+4<=bytes; k+=4){
+			out[k/4] = op_word(s, tdi, bits, done + k);
+		}
+		for (; k<bytes; k++){
+			out8[k] = op_byte(s, tdi, bits, done + k);
+		}
+		/* only the last block leaves the shift state */
+		if (!shift(x, (n == left) ? flags : (flags & ~SDR_END), out8, (flags&SDR_CHECK) ? in8 : NULL, n)) return SCAN_ERROR;
+		if (flags&SDR_CHECK){
+			/* whole words, the rest and a last byte with unused bits bytewise */
+			full = (n & 7) ? bytes - 1 : bytes;
+			for (k=0; k+4<=full; k+=4){
+				expected = tdo ? op_word(s, tdo, bits, done + k) : vec_word(&x->tdo_expected, done + k);
+				diff |= (in[k/4] ^ expected) & vec_word(&x->tdo_mask, done + k);
+			}
+			for (; k<bytes; k++){
+				mask = vec_byte(&x->tdo_mask, done + k);
+				if (k == full) mask &= (1 << (n & 7)) - 1;
+				expected = tdo ? op_byte(s, tdo, bits, done + k) : vec_byte(&x->tdo_expected, done + k);
+				//chprintf(dbg, "TDO actual: %02X idx: %d\r\n", in8[k], done + k);
+				diff |= (in8[k] ^ expected) & mask;
 			}
 		}
-		if (tdo)
-			tdo[i] = in;
+		done += bytes;
+		left -= n;
 	}
+	return diff ? 1 : 0;
 }
 
-static int sdr(int flags){
-	int failTimes=0;
-	uint8_t tdo_actual[MAX_SIZE];
+/* DR scan of the operand at offset 1, TDO is checked as in scan() */
+static int sdr(XSVF_CTX_ST *x, int flags, const XSVF_SRC_ST *s, uint32_t tdo){
+	uint32_t t0 = prof_now(), t;
+	int failTimes=0, res;
 
 	if (flags&SDR_BEGIN) {
-		state_goto(STATE_SHIFT_DR);
+		state_goto(x, STATE_SHIFT_DR);
 	}
 
 	/* data processing loop */
 	while (1){
+		t = prof_now();
 
-		shift(flags, tdi_value, tdo_actual, sdr_size);
-
-		if (flags&SDR_CHECK){
-			int i;
-			int equal = 1;
-
-			for (i=0; i<BYTES(sdr_size); i++){
-				uint8_t expected,actual;
-				expected = tdo_expected[i] & tdo_mask[i];
-				actual = tdo_actual[i] & tdo_mask[i];
-				//chprintf(dbg, "TDO actual: %02X idx: %d\r\n", tdo_actual[i], i);
-				if (expected!=actual) {
-					equal = 0;
-					break;
-				}
-			}
-
-			/* compare the TDO value against the expected TDO value */
-			if (equal){
-				/* TDO matched what was expected */
-				//chprintf(dbg, "TDO matched.\r\n");
-				break;
-			} 
-			else{
-				/* TDO did not match the value expected */
-				//chprintf(dbg, "TDO didn't match.\r\n");
-				failTimes++;
-				/* update failure count */
-				if (failTimes>repeat){
-					//chprintf(dbg, "Max. Repeats reached!.\r\n");
-					return 1;
-				}
-				/* ISP failed */
-				state_step(0); /* Pause-DR state */
-				state_step(1); /* Exit2-DR state */
-				state_step(0); /* Shift-DR state */
-				state_step(1); /* Exit1-DR state */
-				//chprintf(dbg, "Trying again....\r\n");
-
-				state_goto(STATE_RTI);
-				//chprintf(dbg, "State ch.1\r\n");
-				delay(run_test);
-				//chprintf(dbg, "delay1\r\n");
-				state_goto(STATE_SHIFT_DR);
-				//chprintf(dbg, "State ch.2\r\n");
-			}
-		} 
-		else{
-			/* No TDO check - exit */
+		/* compare the TDO value against the expected TDO value */
+		res = scan(x, flags, s, 1, tdo, x->sdr_size);
+		if (res == 0){
+			/* TDO matched what was expected, or there was no check */
+			//chprintf(dbg, "TDO matched.\r\n");
 			break;
 		}
+		if (res == SCAN_ERROR){
+			/* no retry, the TAP state is unknown */
+			prof_add(PROF_SDR, t0);
+			return 1;
+		}
+		/* TDO did not match the value expected */
+		//chprintf(dbg, "TDO didn't match.\r\n");
+		failTimes++;
+		/* update failure count */
+		if (failTimes>x->repeat){
+			//chprintf(dbg, "Max. Repeats reached!.\r\n");
+			prof_add(PROF_SDR, t0);
+			return 1;
+		}
+		/* ISP failed */
+		state_step(x, 0); /* Pause-DR state */
+		state_step(x, 1); /* Exit2-DR state */
+		state_step(x, 0); /* Shift-DR state */
+		state_step(x, 1); /* Exit1-DR state */
+		//chprintf(dbg, "Trying again....\r\n");
+
+		state_goto(x, STATE_RTI);
+		//chprintf(dbg, "State ch.1\r\n");
+		delay(x->run_test);
+		//chprintf(dbg, "delay1\r\n");
+		state_goto(x, STATE_SHIFT_DR);
+		//chprintf(dbg, "State ch.2\r\n");
+		prof_add(PROF_RETRY, t);
 	}
 	if (flags&SDR_END){
-		state_goto(STATE_RTI);
+		state_goto(x, x->end_dr);
 	}
 
-	delay(run_test);
+	delay(x->run_test);
+	prof_add(PROF_SDR, t0);
 	return 0;
 }
 
-void read_byte(uint8_t *data, uint8_t *buf){
-	*data = *buf;
+/*
+ * Next XSDRINC vector in t, an XSDR instruction of n operand bytes: the
+ * bits under address_mask count up by one, the bits under data_mask take
+ * the data_bits long operand at offset off of s, its LSB going to the
+ * lowest mask bit.
+ */
+static void sdr_inc_next(XSVF_CTX_ST *x, uint8_t *t, uint32_t n, const XSVF_SRC_ST *s, uint32_t off){
+	uint32_t j, d = 0;
+	uint8_t carry = 1, m, *b;
+
+	for (j=0; j<x->sdr_size; j++){
+		m = 1 << (j & 7);
+		b = &t[n - (j >> 3)];
+		if (x->address_mask[j >> 3] & m) {
+			if (carry) {
+				carry = (*b & m) ? 1 : 0;
+				*b ^= m;
+			}
+		} else if (x->data_mask[j >> 3] & m) {
+			if (op_byte(s, off, x->data_bits, d >> 3) & (1 << (d & 7))) *b |= m;
+			else *b &= ~m;
+			d++;
+		}
+	}
 }
 
-uint8_t read_bytes(uint8_t *data, uint8_t *buf, int len){
-	int8_t i=0;
-	for (i=len-1; i>=0; --i){
-		data[i] = *(buf++);
+/*
+ * XSDRINC: start vector, number of increments, data of each increment.
+ * Every vector is played like an XSDR, so TDO is checked against the
+ * last XSDRTDO.
+ */
+static int sdr_inc(XSVF_CTX_ST *x, const XSVF_SRC_ST *s){
+	uint8_t t[1 + MAX_SIZE];
+	XSVF_SRC_ST ts = { t, 0, NULL };
+	uint32_t k, times, n = BYTES(x->sdr_size);
+
+	t[0] = XSDR;
+	for (k=0; k<n; k++){
+		t[1 + k] = src_byte(s, 1 + k);
 	}
-	return len;
+	ts.n = 1 + n;
+	times = src_byte(s, 1 + n);
+	for (k=0; k<=times; k++){
+		if (k) sdr_inc_next(x, t, n, s, 2 + n + (k - 1) * BYTES(x->data_bits));
+		if (sdr(x, SDR_FULL|SDR_CHECK, &ts, 0)) return 1;
+	}
+	return 0;
 }
 
-uint8_t read_long(uint32_t *data, uint8_t *buf){
+void read_byte(uint8_t *data, const uint8_t *buf){
+	*data = *buf;
+}
+
+uint8_t read_long(uint32_t *data, const uint8_t *buf){
 	uint32_t temp = *(buf++) * 16777216;
 	temp += *(buf++) * 65536;
 	temp += *(buf++) * 256;
@@ -297,7 +407,7 @@ uint8_t read_long(uint32_t *data, uint8_t *buf){
 }
 
 void fail(void){
-		chprintf(dbg, "---------FAIL!\r\n");
+		DLOG("---------FAIL!\r\n");
 }
 
 void send_response(uint16_t chunk, uint16_t pos){
@@ -312,166 +422,650 @@ void send_response(uint16_t chunk, uint16_t pos){
 	else if (pos > chunk * 9) streamPut(ost, 9); // 90% 
 }
 
-uint16_t write_xsvf(uint16_t len, uint8_t * buf){
-	uint16_t i=0; // Counter variable
-	uint8_t length; /* hold the length of the arguments to read in */
+/*
+ * Size of the instruction at buf including the opcode.
+ * Returns 0 if more than avail bytes are needed to tell, -1 if it can't be played.
+ */
+static int32_t inst_size(XSVF_CTX_ST *x, const uint8_t *buf, uint32_t avail){
+	uint32_t n = BYTES(x->sdr_size);
+
+	switch (buf[0]) {
+	case XCOMPLETE:
+		return 1;
+	case XREPEAT:
+	case XSTATE:
+	case XENDIR:
+	case XENDDR:
+		return 2;
+	case XRUNTEST:
+	case XSDRSIZE:
+		return 5;
+	case XWAIT:
+		return 7;
+	case XWAITSTATE:
+		return 11;
+	case XSIR:
+		if (avail < 2) return 0;
+		return 2 + BYTES(buf[1]);
+	case XSIR2:
+		if (avail < 3) return 0;
+		return 3 + BYTES(((buf[1] << 8) | buf[2]));
+	case XTDOMASK:
+	case XSDR:
+	case XSDRB:
+	case XSDRC:
+	case XSDRE:
+		return 1 + n;
+	case XSDRTDO:
+	case XSDRTDOB:
+	case XSDRTDOC:
+	case XSDRTDOE:
+		return 1 + 2*n;
+	case XSETSDRMASKS:
+		return (n > MAX_SIZE) ? -1 : (int32_t)(1 + 2*n);
+	case XSDRINC:
+		/* the masks are limited to MAX_SIZE, so are the vector and the data */
+		if ((n > MAX_SIZE) || (x->data_bits > 8 * MAX_SIZE)) return -1;
+		if (avail < 2 + n) return 0;
+		return 2 + n + buf[1 + n] * BYTES(x->data_bits);
+	default: // everything unknown
+		return -1;
+	}
+}
+
+/* Is the bits long XSIR operand at offset off already in the IR? */
+static bool ir_cached(XSVF_CTX_ST *x, const XSVF_SRC_ST *s, uint32_t off, uint32_t bits){
+	uint32_t k, n = BYTES(bits);
+
+	if (!x->ir_cache || !x->ir_valid || (x->ir_bits != bits)) return false;
+	for (k=0; k<n; k++){
+		if (src_byte(s, off + k) != x->ir_shadow[k]) return false;
+	}
+	return true;
+}
+
+/* Remembers the operand of an XSIR, IRs longer than the shadow are not cached. */
+static void ir_keep(XSVF_CTX_ST *x, const XSVF_SRC_ST *s, uint32_t off, uint32_t bits){
+	uint32_t k, n = BYTES(bits);
+
+	x->ir_valid = (n <= MAX_SIZE);
+	if (!x->ir_valid) return;
+	for (k=0; k<n; k++){
+		x->ir_shadow[k] = src_byte(s, off + k);
+	}
+	x->ir_bits = bits;
+}
+
+/*
+ * Plays one complete instruction of size bytes. The fixed size fields are
+ * read from a copy of its head, the scan operands straight from s.
+ */
+static xsvf_result_t exec_inst(XSVF_CTX_ST *x, const XSVF_SRC_ST *s, uint32_t size){
+	uint8_t buf[INST_HEAD];
+	uint16_t i=1; // Operand index
+	uint32_t length; /* hold the length of the arguments to read in */
 	uint8_t inst; /* instruction */
-	uint32_t temp32;
-	//static uint16_t sdr_bytes;
-	// len is the total length of the xsvf file
-	uint16_t chunk = len / 10;
-	//chprintf(dbg, "XSVF: Length: %d\r\n", len);
-	while (i < len){
-		//chprintf(dbg, "%02X ", buf[i]);
-		switch (buf[i++]) {
+	uint32_t wait_us, clocks, k;
+	uint32_t n = BYTES(x->sdr_size);
 
-		case XCOMPLETE: // 00
-			chprintf(dbg, "Complete. %d\r\n", i);
-			chprintf(ost, "F"); // Done Programming
-			break;
+	for (k=0; (k<INST_HEAD) && (k<size); k++){
+		buf[k] = src_byte(s, k);
+	}
 
-		case XTDOMASK: // 01
-			i += read_bytes(tdo_mask, &(buf[i]), BYTES(sdr_size));
-			// streamPut(ost, 1);
-			//chprintf(dbg, "Set TDOMASK to %02X %02X %02X %02X\r\n", tdo_mask[0], tdo_mask[1], tdo_mask[2], tdo_mask[3]);
-			break;
+	switch (buf[0]) {
 
-		case XREPEAT: // 07
-			read_byte(&repeat, &(buf[i++]));
-			// streamPut(ost, 7);
-			//chprintf(dbg, "Set REPEAT to %02X\r\n", repeat);
-			break;
+	case XCOMPLETE: // 00
+		DLOG("Complete.\r\n");
+		/* the next file starts with the XSVF defaults */
+		x->end_ir = STATE_RTI;
+		x->end_dr = STATE_RTI;
+		return XSVF_DONE;
 
-		case XRUNTEST: // 04
-			i += read_long(&run_test, &(buf[i]));
-			// streamPut(ost, 4);
-			//chprintf(dbg, "Set RUNTEST to %08X\r\n", run_test);
-			break;
+	case XTDOMASK: // 01
+		vec_load(&x->tdo_mask, s, 1, x->sdr_size);
+		if (!x->tdo_mask.ok) {
+			/* beyond XSVF_VEC_SIZE bytes only a repeated byte can be kept */
+			DLOG("TDO mask too irregular.\r\n");
+			fail();
+			return XSVF_FAIL;
+		}
+		// streamPut(ost, 1);
+		//chprintf(dbg, "Set TDOMASK to %02X %02X %02X %02X\r\n", x->tdo_mask.head[0], x->tdo_mask.head[1], x->tdo_mask.head[2], x->tdo_mask.head[3]);
+		break;
 
-		case XSIR: // 02
-			read_byte(&length, &(buf[i++]));
-			//chprintf(dbg, "XSIR Read %d Bytes\r\n", BYTES(length));
-			i += read_bytes(tdi_value, &(buf[i]), BYTES(length));
-			//chprintf(dbg, "Set TDIVAL to %02X %02X %02X %02X\r\n", tdi_value[0], tdi_value[1], tdi_value[2], tdi_value[3]);
-			state_goto(STATE_SHIFT_IR);
-			shift(SDR_END, tdi_value, 0, length);
-			state_goto(STATE_RTI);
-			// streamPut(ost, 2);
-			break;
+	case XREPEAT: // 07
+		read_byte(&x->repeat, &(buf[i++]));
+		// streamPut(ost, 7);
+		//chprintf(dbg, "Set REPEAT to %02X\r\n", x->repeat);
+		break;
 
-		case XSDR: // 03
-			i += read_bytes(tdi_value, &(buf[i]), BYTES(sdr_size));
-			//chprintf(dbg, "Set TDIVAL to %02X %02X %02X %02X\r\n", tdi_value[0], tdi_value[1], tdi_value[2], tdi_value[3]);
-			if (sdr(SDR_FULL|SDR_CHECK)) {
-				fail();
-				return 0;
-			}
-			// streamPut(ost, 3);
-			break;
+	case XRUNTEST: // 04
+		i += read_long(&x->run_test, &(buf[i]));
+		// streamPut(ost, 4);
+		//chprintf(dbg, "Set RUNTEST to %08X\r\n", x->run_test);
+		break;
 
-		case XSDRSIZE: // 08
-			i += read_long(&sdr_size, &(buf[i]));
-			//sdr_size = temp32;
-			//sdr_size = (sdr_size+7)>>3; // The +7 should be useless since 7>>3 == 0!
-			//chprintf(dbg, "Set XDRSIZE to %04X or %04X\r\n", sdr_size, BYTES(sdr_size));
-			// streamPut(ost, 8);
+	case XSIR: // 02
+	case XSIR2: // 15
+		/* XSIR2 has a 16 bit length for long IR chains */
+		length = buf[i++];
+		if (buf[0] == XSIR2) length = (length << 8) | buf[i++];
+		//chprintf(dbg, "XSIR Read %d Bytes\r\n", BYTES(length));
+		if (ir_cached(x, s, i, length)) {
+			/* same instruction again, Update-IR would change nothing */
+			x->ir_skipped++;
+			state_goto(x, x->end_ir);
 			break;
+		}
+		state_goto(x, STATE_SHIFT_IR);
+		if (scan(x, SDR_END, s, i, 0, length) == SCAN_ERROR) {
+			fail();
+			return XSVF_FAIL;
+		}
+		ir_keep(x, s, i, length);
+		state_goto(x, x->end_ir);
+		// streamPut(ost, 2);
+		break;
 
-		case XSDRTDO: // 09
-			i += read_bytes(tdi_value, &(buf[i]), BYTES(sdr_size));
-			i += read_bytes(tdo_expected, &(buf[i]), BYTES(sdr_size));
-			//chprintf(dbg, "Set TDIVAL to %02X %02X %02X %02X\r\n", tdi_value[0], tdi_value[1], tdi_value[2], tdi_value[3]);
-			//chprintf(dbg, "Set TDOEXP to %02X %02X %02X %02X\r\n", tdo_expected[0], tdo_expected[1], tdo_expected[2], tdo_expected[3]);
-			if (sdr(SDR_FULL|SDR_CHECK)) {
-				fail();
-				return 0;
-			}
-			//// streamPut(ost, 9);
-			break;
+	case XSDR: // 03
+		/* checked against the last XSDRTDO, which must have been kept */
+		if ((n > XSVF_VEC_SIZE) && x->tdo_mask.fill && !x->tdo_expected.ok) {
+			DLOG("TDO expected value too irregular.\r\n");
+			fail();
+			return XSVF_FAIL;
+		}
+		if (sdr(x, SDR_FULL|SDR_CHECK, s, 0)) {
+			fail();
+			return XSVF_FAIL;
+		}
+		// streamPut(ost, 3);
+		break;
 
-		case XSDRB:
-			i += read_bytes(tdi_value, &(buf[i]), BYTES(sdr_size));
-			sdr(SDR_BEGIN|SDR_NOCHECK);
-			// streamPut(ost, 12);
-			break;
+	case XSDRSIZE: // 08
+		i += read_long(&x->sdr_size, &(buf[i]));
+		if (x->sdr_size > XSVF_SDR_MAX) {
+			DLOG("XSDRSIZE %u too long.\r\n", x->sdr_size);
+			x->sdr_size = 0;
+			fail();
+			return XSVF_FAIL;
+		}
+		//chprintf(dbg, "Set XDRSIZE to %04X or %04X\r\n", x->sdr_size, BYTES(x->sdr_size));
+		// streamPut(ost, 8);
+		break;
 
-		case XSDRC:
-			i += read_bytes(tdi_value, &(buf[i]), BYTES(sdr_size));
-			sdr(SDR_CONTINUE|SDR_NOCHECK);
-			// streamPut(ost, 13);
-			break;
+	case XSDRTDO: // 09
+		vec_load(&x->tdo_expected, s, 1 + n, x->sdr_size);
+		if (sdr(x, SDR_FULL|SDR_CHECK, s, 1 + n)) {
+			fail();
+			return XSVF_FAIL;
+		}
+		//// streamPut(ost, 9);
+		break;
 
-		case XSDRE:
-			i += read_bytes(tdi_value, &(buf[i]), BYTES(sdr_size));
-			sdr(SDR_END|SDR_NOCHECK);
-			// streamPut(ost, 14);
-			break;
+	case XSDRB:
+		/* without the check, sdr() only fails if the engine did */
+		if (sdr(x, SDR_BEGIN|SDR_NOCHECK, s, 0)) {
+			fail();
+			return XSVF_FAIL;
+		}
+		// streamPut(ost, 12);
+		break;
+
+	case XSDRC:
+		if (sdr(x, SDR_CONTINUE|SDR_NOCHECK, s, 0)) {
+			fail();
+			return XSVF_FAIL;
+		}
+		// streamPut(ost, 13);
+		break;
+
+	case XSDRE:
+		if (sdr(x, SDR_END|SDR_NOCHECK, s, 0)) {
+			fail();
+			return XSVF_FAIL;
+		}
+		// streamPut(ost, 14);
+		break;
 
-		case XSDRTDOB:
-			i += read_bytes(tdi_value, &(buf[i]), BYTES(sdr_size));
-			i += read_bytes(tdo_expected, &(buf[i]), BYTES(sdr_size));
-			if (sdr(SDR_BEGIN|SDR_CHECK)) {
+	case XSDRTDOB:
+		vec_load(&x->tdo_expected, s, 1 + n, x->sdr_size);
+		if (sdr(x, SDR_BEGIN|SDR_CHECK, s, 1 + n)) {
+			fail();
+			return XSVF_FAIL;
+		}
+		// streamPut(ost, 15);
+		break;
+
+	case XSDRTDOC:
+		vec_load(&x->tdo_expected, s, 1 + n, x->sdr_size);
+		if (sdr(x, SDR_CONTINUE|SDR_CHECK, s, 1 + n)) {
+			fail();
+			return XSVF_FAIL;
+		}
+		// streamPut(ost, 16);
+		break;
+
+	case XSDRTDOE:
+		vec_load(&x->tdo_expected, s, 1 + n, x->sdr_size);
+		if (sdr(x, SDR_END|SDR_CHECK, s, 1 + n)) {
+			fail();
+			return XSVF_FAIL;
+		}
+		// streamPut(ost, 17);
+		break;
+
+	case XSETSDRMASKS:
+		x->data_bits = 0;
+		for (k=0; k<n; k++){
+			x->address_mask[k] = op_byte(s, 1, x->sdr_size, k);
+			x->data_mask[k] = op_byte(s, 1 + n, x->sdr_size, k);
+			/* the unused top bits of the last byte carry no data */
+			if ((k == n - 1) && (x->sdr_size & 7)) x->data_mask[k] &= (1 << (x->sdr_size & 7)) - 1;
+			x->data_bits += __builtin_popcount(x->data_mask[k]);
+		}
+		// streamPut(ost, 10);
+		break;
+
+	case XSTATE:
+		if (buf[i] > STATE_UPDATE_IR) {
+			fail();
+			return XSVF_FAIL;
+		}
+		read_byte(&inst, &(buf[i++]));
+		//chprintf(dbg, "Goto STATE: %02X\r\n", inst);
+		state_goto(x, inst);
+		// streamPut(ost, 18);
+		break;
+
+	case XENDIR: // 13
+		/* 0: Run-Test/Idle, 1: Pause-IR, so the next scan needs no RTI round trip */
+		if (buf[i] > 1) {
+			fail();
+			return XSVF_FAIL;
+		}
+		x->end_ir = buf[i++] ? STATE_PAUSE_IR : STATE_RTI;
+		break;
+
+	case XENDDR: // 14
+		/* 0: Run-Test/Idle, 1: Pause-DR */
+		if (buf[i] > 1) {
+			fail();
+			return XSVF_FAIL;
+		}
+		x->end_dr = buf[i++] ? STATE_PAUSE_DR : STATE_RTI;
+		break;
+
+	case XWAIT: // 17
+	case XWAITSTATE: // 18
+		/* wait state, end state, microsec [, XWAITSTATE: TCK cycles before microsec] */
+		if (buf[1] > STATE_UPDATE_IR || buf[2] > STATE_UPDATE_IR) {
+			fail();
+			return XSVF_FAIL;
+		}
+		read_long(&wait_us, &buf[3]);
+		clocks = 0;
+		if (buf[0] == XWAITSTATE) {
+			clocks = wait_us;
+			read_long(&wait_us, &buf[7]);
+		}
+		state_goto(x, buf[1]);
+		jtag_wait(wait_us, clocks);
+		state_goto(x, buf[2]);
+		break;
+
+	case XSDRINC: // 0B
+		if (sdr_inc(x, s)) {
+			fail();
+			return XSVF_FAIL;
+		}
+		break;
+
+	default: // everything unknown
+		fail();
+		return XSVF_FAIL;
+	}
+	return XSVF_OK;
+}
+
+static xsvf_result_t xsvf_exec(XSVF_CTX_ST *x, const XSVF_SRC_ST *s, uint32_t size){
+	uint32_t t0 = prof_now();
+	uint8_t op = src_byte(s, 0);
+	xsvf_result_t res = exec_inst(x, s, size);
+
+	if (op < PROF_OPCODES) prof_add(op, t0);
+	x->executed++;
+	/* after XCOMPLETE or a failure the next file may talk to another target */
+	if (res != XSVF_OK) x->ir_valid = 0;
+	return res;
+}
+
+/* Drops a partially received instruction, the next byte is an opcode again. */
+void xsvf_reset(XSVF_CTX_ST *x){
+	x->have = 0;
+	x->need = 0;
+}
+
+/*
+ * Feeds the next len bytes of an XSVF file into the player.
+ * The fragments may be split anywhere, even inside an instruction:
+ * complete instructions are played straight from buf, an instruction
+ * which doesn't fit is gathered in the context until the rest arrives
+ * with the following calls. That takes at most XSVF_INST_SIZE bytes,
+ * longer instructions have to arrive in one fragment.
+ */
+xsvf_result_t xsvf_feed(XSVF_CTX_ST *x, const uint8_t *buf, uint32_t len){
+	uint32_t pos = 0, n;
+	int32_t size;
+	xsvf_result_t res;
+	XSVF_SRC_ST s = { NULL, 0, NULL };
+	uint16_t chunk = len / 10;
+
+	while (pos < len){
+		if (x->have == 0) {
+			/* fast path, the whole instruction is in buf */
+			size = inst_size(x, &buf[pos], len - pos);
+			if (size < 0) {
 				fail();
-				return 0;
+				xsvf_reset(x);
+				return XSVF_FAIL;
 			}
-			// streamPut(ost, 15);
-			break;
-
-		case XSDRTDOC:
-			i += read_bytes(tdi_value, &(buf[i]), BYTES(sdr_size));
-			i += read_bytes(tdo_expected, &(buf[i]), BYTES(sdr_size));
-			if (sdr(SDR_CONTINUE|SDR_CHECK)) {
+			if ((size > 0) && ((uint32_t)size <= len - pos)) {
+				s.p = &buf[pos];
+				s.n = size;
+				res = xsvf_exec(x, &s, size);
+				pos += size;
+				if (res != XSVF_OK) {
+					xsvf_reset(x);
+					return res;
+				}
+				if (x->progress) send_response(chunk, pos);
+				continue;
+			}
+		}
+		/* collect the instruction in the context */
+		if (x->need == 0) {
+			x->inst[x->have++] = buf[pos++];
+			size = inst_size(x, x->inst, x->have);
+			if (size < 0) {
 				fail();
-				return 0;
+				xsvf_reset(x);
+				return XSVF_FAIL;
 			}
-			// streamPut(ost, 16);
-			break;
-
-		case XSDRTDOE:
-			i += read_bytes(tdi_value, &(buf[i]), BYTES(sdr_size));
-			i += read_bytes(tdo_expected, &(buf[i]), BYTES(sdr_size));
-			if (sdr(SDR_END|SDR_CHECK)) {
+			if ((uint32_t)size > sizeof(x->inst)) {
+				/* only played in place, it must not be split */
+				DLOG("Instruction of %d bytes split, exceeds XSVF_INST_SIZE.\r\n", size);
 				fail();
-				return 0;
+				xsvf_reset(x);
+				return XSVF_FAIL;
 			}
-			// streamPut(ost, 17);
-			break;
+			x->need = size;
+		}
+		if (x->need) {
+			n = x->need - x->have;
+			if (n > len - pos) n = len - pos;
+			memcpy(&x->inst[x->have], &buf[pos], n);
+			x->have += n;
+			pos += n;
+			if (x->have == x->need) {
+				s.p = x->inst;
+				s.n = x->have;
+				res = xsvf_exec(x, &s, x->have);
+				xsvf_reset(x);
+				if (res != XSVF_OK) return res;
+				if (x->progress) send_response(chunk, pos);
+			}
+		}
+	}
+	return XSVF_OK;
+}
 
-		case XSETSDRMASKS:
-			i += read_bytes(address_mask, &(buf[i]), BYTES(sdr_size));
-			i += read_bytes(data_mask, &(buf[i]), BYTES(sdr_size));
-			// streamPut(ost, 10);
-			break;
+/* Forget a partial instruction, e.g. when an upload was abandoned. */
+void xsvf_player_reset(void){
+	xsvf_reset(&player);
+	player.ir_valid = 0;
+	in_file = false;
+}
 
-		case XSDRINC:
-			fail();
-			return 0;
-			break;
+/*
+ * Takes the TAP to Run-Test/Idle from any state and tells the player, for
+ * code which drives the pins between jobs, e.g. the shell benchmark.
+ */
+void xsvf_tap_idle(void){
+	state_goto(&player, STATE_TLR);
+	state_goto(&player, STATE_RTI);
+}
 
-		case XSTATE:
-			read_byte(&inst, &(buf[i++]));
-			//chprintf(dbg, "Goto STATE: %02X\r\n", inst);
-			state_goto(inst);
-			// streamPut(ost, 18);
-			break;
+/* Opt-out of the IR shadow, it takes effect with the next XSIR. */
+void xsvf_set_ir_cache(bool on){
+	player.ir_cache = on;
+}
+
+/* Number of XSIR scans skipped since power-up. */
+uint32_t xsvf_ir_skipped(bool *on){
+	if (on) *on = player.ir_cache;
+	return player.ir_skipped;
+}
 
-		default:
+/* Number of instructions played since power-up. */
+uint32_t xsvf_executed(void){
+	return player.executed;
+}
+
+/*
+ * Plays the next chunk, instructions may continue into the following chunk.
+ * Returns 2 after XCOMPLETE, 1 if the file goes on, 0 on failure.
+ * progress sends the v1 progress bytes, the caller answers 'F' or 'X'.
+ */
+uint16_t write_xsvf(uint16_t len, uint8_t * buf, bool progress){
+	uint32_t t0 = prof_now();
+	xsvf_result_t res;
+
+	//chprintf(dbg, "XSVF: Length: %d\r\n", len);
+	if (in_file) prof_add(PROF_IDLE, chunk_end);
+	xsvf_tck_update();
+	player.progress = progress;
+	res = xsvf_feed(&player, buf, len);
+	prof_add(PROF_CHUNK, t0);
+	in_file = (res == XSVF_OK);
+	chunk_end = prof_now();
+	if (res == XSVF_FAIL) return 0;
+	return (res == XSVF_DONE) ? 2 : 1;
+}
+
+/*
+ * Plays a new file out of the ring while it is still being received, so
+ * the upload of the next bytes overlaps with the JTAG activity. Each
+ * instruction is played in place once it is complete in the ring. One
+ * longer than the ring is read out into spill as it arrives and played
+ * from there, so it may be as long as spill_size.
+ * Returns 1 after XCOMPLETE, 0 on failure, timeout or abort.
+ */
+uint16_t stream_xsvf(RING_ST *ring, uint8_t *spill, uint32_t spill_size, sysinterval_t timeout){
+	uint8_t head[2 + MAX_SIZE];
+	XSVF_SRC_ST s;
+	uint32_t avail, k, n, t0;
+	int32_t size;
+	xsvf_result_t res;
+	msg_t msg;
+
+	xsvf_tck_update();
+	xsvf_reset(&player);
+	player.progress = 0;
+	while (1){
+		/* enough of the instruction to know its size */
+		size = 0;
+		avail = 0;
+		while (size == 0){
+			t0 = prof_now();
+			msg = ring_wait(ring, avail + 1, timeout);
+			prof_add(PROF_IDLE, t0);
+			if (msg != MSG_OK) return 0;
+			avail = ring_count(ring);
+			for (k=0; (k<avail) && (k<sizeof(head)); k++){
+				head[k] = ring_peek(ring, k);
+			}
+			size = inst_size(&player, head, k);
+		}
+		if ((size < 0) || (((uint32_t)size > ring_size(ring)) && ((uint32_t)size > spill_size))) {
+			if (size > 0) DLOG("Instruction of %d bytes exceeds the stream.\r\n", size);
 			fail();
 			return 0;
 		}
-		send_response(chunk, i);
+		if ((uint32_t)size > ring_size(ring)) {
+			/* the receiver fills the ring again while it is read out */
+			for (k=0; k<(uint32_t)size; k+=n){
+				t0 = prof_now();
+				msg = ring_wait(ring, 1, timeout);
+				prof_add(PROF_IDLE, t0);
+				if (msg != MSG_OK) return 0;
+				n = ring_read(ring, &spill[k], size - k);
+			}
+			s.p = spill;
+			s.n = size;
+			s.wrap = NULL;
+			res = xsvf_exec(&player, &s, size);
+		} else {
+			t0 = prof_now();
+			msg = ring_wait(ring, size, timeout);
+			prof_add(PROF_IDLE, t0);
+			if (msg != MSG_OK) return 0;
+			s.p = ring_read_ptr(ring, &s.n);
+			s.wrap = ring_wrap_ptr(ring);
+			res = xsvf_exec(&player, &s, size);
+			/* the ring keeps the bytes until the instruction was played */
+			ring_skip(ring, size);
+		}
+		if (res != XSVF_OK) return (res == XSVF_DONE) ? 1 : 0;
 	}
-	return 1;
-	//chprintf(dbg, "\r\n");
 }
 
-void xsvf_init(void){
-  palSetLineMode(TDO_PIN, PAL_MODE_INPUT_PULLDOWN);
-  TDI_IDLE;
-  TMS_IDLE;
-  TCK_IDLE;
-  palSetLineMode(TDI_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
-  palSetLineMode(TMS_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
-  palSetLineMode(TCK_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+/* Rates of all shift paths for hz, apply them only while nothing is shifted. */
+static void tck_rates(uint32_t hz, bool apply, XSVF_TCK_ST *res){
+	res->request = hz;
+	res->tck = jtag_tck_rate(hz, apply);
+	res->engine = 0;
+#if XSVF_USE_SPI
+	res->engine = jtag_spi_rate(hz, apply);
+#elif XSVF_USE_WAVE
+	res->engine = jtag_dma_rate(hz, apply);
+#endif
+#if XSVF_WAIT_FREE_RUN && !XSVF_USE_WAVE
+	/* the free-running clock of the waits keeps the rate of the kernels */
+	jtag_dma_rate(res->tck, apply);
+#endif
+}
+
+/*
+ * Host request for a TCK rate of at most hz (0: power-up default). The
+ * achieved rates are known right away, the worker switches to them
+ * before it plays the next job.
+ */
+void xsvf_set_tck(uint32_t hz, XSVF_TCK_ST *res){
+	tck_rates(hz, false, res);
+	chSysLock();
+	tck = *res;
+	tck_pending = true;
+	chSysUnlock();
+}
+
+void xsvf_get_tck(XSVF_TCK_ST *res){
+	chSysLock();
+	*res = tck;
+	chSysUnlock();
+}
+
+/* Worker side: takes over a new TCK rate. */
+void xsvf_tck_update(void){
+	XSVF_TCK_ST t;
+	uint32_t hz;
+
+	if (!tck_pending) return;
+	chSysLock();
+	hz = tck.request;
+	tck_pending = false;
+	chSysUnlock();
+	tck_rates(hz, true, &t);
+}
+
+/*
+ * One auto-tune probe: IDCODE out of a TAP reset, then all IRs of the
+ * chain filled with ones (BYPASS) and the pattern looped through.
+ */
+static bool tune_probe(const uint8_t *pattern, uint8_t *tdo, uint32_t *idcode){
+	XSVF_CTX_ST *x = &player;
+	uint8_t buf[TUNE_IR_BITS/8], id[4];
+
+	state_goto(x, STATE_TLR);
+	state_goto(x, STATE_SHIFT_DR);
+	memset(buf, 0, sizeof(id));
+	shift(x, SDR_END, buf, id, 32);
+	*idcode = id[0] | (id[1] << 8) | (id[2] << 16) | ((uint32_t)id[3] << 24);
+	state_goto(x, STATE_SHIFT_IR);
+	memset(buf, 0xff, sizeof(buf));
+	shift(x, SDR_END, buf, NULL, TUNE_IR_BITS);
+	state_goto(x, STATE_SHIFT_DR);
+	shift(x, SDR_END, pattern, tdo, TUNE_BITS);
+	state_goto(x, STATE_TLR);
+	return true;
+}
+
+/* the sweep compares the faster of the kernel and the engine rate */
+static uint32_t tune_set_rate(uint32_t hz){
+	XSVF_TCK_ST t;
 
+	xsvf_set_tck(hz, &t);
+	xsvf_tck_update();
+	return (t.engine > t.tck) ? t.engine : t.tck;
+}
+
+static const TUNE_OPS_ST tune_ops = { tune_set_rate, tune_probe };
+
+/*
+ * Worker side: finds the fastest reliable TCK rate for the TAP on the
+ * port and keeps it set. The result is remembered per IDCODE, force
+ * sweeps again. Returns the rate, 0 if no TAP answered, the old rate
+ * stays set then.
+ */
+uint32_t xsvf_autotune(bool force, uint32_t *idcode){
+	uint8_t pattern[TUNE_BITS/8], tdo[TUNE_BITS/8];
+	XSVF_TCK_ST old;
+	uint32_t hz;
+
+	xsvf_get_tck(&old);
+	tune_set_rate(XSVF_TUNE_MIN_HZ);
+	tune_pattern(pattern, TUNE_BITS, 0);
+	tune_probe(pattern, tdo, idcode);
+	hz = 0;
+	if (tune_idcode_valid(*idcode)) {
+		hz = force ? 0 : tune_cache_get(*idcode);
+		if (hz) return tune_set_rate(hz);
+		hz = tune_sweep(&tune_ops, XSVF_TUNE_MIN_HZ, XSVF_TUNE_MAX_HZ, XSVF_TUNE_MARGIN, idcode);
+	}
+	if (hz == 0) {
+		tune_set_rate(old.request);
+		return 0;
+	}
+	tune_cache_put(*idcode, hz);
+	return hz;
+}
+
+void xsvf_init(void){
+  memset(&player, 0, sizeof(player));
+  player.end_ir = STATE_RTI;
+  player.end_dr = STATE_RTI;
+  player.ir_cache = XSVF_IR_CACHE;
+  in_file = false;
+  prof_clear();
+  tms_paths_init();
+  jtag_init();
+#if XSVF_USE_SPI
+  jtag_spi_init();
+#endif
+#if JTAG_DMA_CLOCK
+  jtag_dma_init();
+#endif
+  tck_rates(0, false, &tck);
+#if XSVF_WAIT_FREE_RUN && !XSVF_USE_WAVE
+  jtag_dma_rate(tck.tck, true);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+/*
+ * xsvf_prof.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include <string.h>
+#include "xsvf_prof.h"
+
+PROF_ST xsvf_prof;
+
+static const char *const names[PROF_ENTRIES] = {
+  "XCOMPLETE", "XTDOMASK", "XSIR", "XSDR", "XRUNTEST", "5", "6", "XREPEAT",
+  "XSDRSIZE", "XSDRTDO", "XSETSDRMASKS", "XSDRINC", "XSDRB", "XSDRC", "XSDRE",
+  "XSDRTDOB", "XSDRTDOC", "XSDRTDOE", "XSTATE", "XENDIR", "XENDDR", "XSIR2",
+  "22", "XWAIT", "XWAITSTATE",
+  "sdr", "state_goto", "delay", "retry", "idle", "chunk"
+};
+
+static void put_be32(uint8_t *p, uint32_t v){
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+/* Starts a new profile, e.g. before an upload. */
+void prof_clear(void){
+  chSysLock();
+  memset(&xsvf_prof, 0, sizeof(xsvf_prof));
+  xsvf_prof.since = chVTGetSystemTime();
+  chSysUnlock();
+}
+
+/*
+ * Copy of the profile. The worker doesn't lock, so an entry it updates
+ * right now may be off by that one call.
+ */
+void prof_get(PROF_ST *p){
+  chSysLock();
+  *p = xsvf_prof;
+  chSysUnlock();
+}
+
+const char * prof_name(uint32_t k){
+  return (k < PROF_ENTRIES) ? names[k] : "?";
+}
+
+/* Entry idx of the binary record (see xsvf_prof.h), false past the end. */
+bool prof_entry(uint32_t idx, uint8_t *buf){
+  PROF_ENTRY_ST e;
+  systime_t since;
+
+  if (idx > PROF_ENTRIES) return false;
+  memset(buf, 0, PROF_ENTRY_SIZE);
+  if (idx == 0) {
+    chSysLock();
+    since = xsvf_prof.since;
+    chSysUnlock();
+    buf[0] = 'P';
+    buf[1] = PROF_VERSION;
+    buf[2] = PROF_ENTRIES + 1;
+    put_be32(&buf[4], STM32_SYSCLK);
+    put_be32(&buf[8], TIME_I2MS(chVTGetSystemTime() - since));
+    return true;
+  }
+  chSysLock();
+  e = xsvf_prof.e[idx - 1];
+  chSysUnlock();
+  buf[0] = idx - 1;
+  put_be32(&buf[4], e.count);
+  put_be32(&buf[8], (uint32_t)(e.cycles >> 32));
+  put_be32(&buf[12], (uint32_t)e.cycles);
+  return true;
+}
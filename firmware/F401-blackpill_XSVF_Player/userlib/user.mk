@@ -3,6 +3,19 @@ USERLIB = ./userlib
 USERSRC =  $(USERLIB)/src/comm.c \
            $(USERLIB)/src/usbcfg.c\
            $(USERLIB)/src/xsvf.c\
+           $(USERLIB)/src/xsvf_prof.c\
+           $(USERLIB)/src/dlog.c\
+           $(USERLIB)/src/jtag.c\
+           $(USERLIB)/src/jtag_plan.c\
+           $(USERLIB)/src/jtag_spi.c\
+           $(USERLIB)/src/jtag_wave.c\
+           $(USERLIB)/src/jtag_dma.c\
+           $(USERLIB)/src/tck_tune.c\
+           $(USERLIB)/src/ring.c\
+           $(USERLIB)/src/jobq.c\
+           $(USERLIB)/src/crc32.c\
+           $(USERLIB)/src/frame.c\
+           $(USERLIB)/src/txq.c\
 		   $(USERLIB)/src/ostrich.c 		   
                      
 # Required include directories
@@ -26,7 +26,13 @@ class x_state(enum.Enum):
     XSDRTDOC     = 16 # 10
     XSDRTDOE     = 17 # 11
     XSTATE       = 18 # 12
-    XSIR2       = 254
+    XENDIR       = 19 # 13
+    XENDDR       = 20 # 14
+    XWAIT        = 23 # 17
+    XWAITSTATE   = 24 # 18
+    XSIR2        = 21 # 15
+    XSIRLEN     = 253
+    XSIR2LEN    = 254
     XIDLE       = 255
 
 class bcolors:
@@ -104,11 +110,15 @@ def xsvf_parser(ser, f):
                     #print(f'sdr: 0x{idx:02X}, 0x{start:02X}, 0x{stop:02X}')
                     #print(f'sdr: 0x{sdr_bytes:04X}')
 
-                if state == x_state.XSIR2:
+                if state == x_state.XSIRLEN:
                     start = idx + 1
-                    stop = idx + (f[idx]>>3)
+                    stop = idx + ((f[idx]+7)>>3)
                     #print(f'sir2: 0x{idx:02X}, 0x{start:02X}, 0x{stop:02X}')
                     state = x_state.XSIR
+                elif state == x_state.XSIR2LEN:
+                    start = idx + 1
+                    stop = idx + ((((f[idx-1]<<8) | f[idx])+7)>>3)
+                    state = x_state.XSIR2
                 else:
                     #print(f'Dumping: {start} - {stop}, {f[start:stop+1]}')
                     dump_val(state, f[start:stop+1], start, sdr_bytes)
@@ -123,7 +133,7 @@ def xsvf_parser(ser, f):
                     state = x_state.XTDOMASK
                     length = sdr_bytes
                 case 2:
-                    state = x_state.XSIR2
+                    state = x_state.XSIRLEN
                     length = 1
                 case 3:
                     state = x_state.XSDR
@@ -164,6 +174,21 @@ def xsvf_parser(ser, f):
                 case 0x12:
                     state = x_state.XSTATE
                     length = 1
+                case 0x13:
+                    state = x_state.XENDIR
+                    length = 1
+                case 0x14:
+                    state = x_state.XENDDR
+                    length = 1
+                case 0x15:
+                    state = x_state.XSIR2LEN
+                    length = 2
+                case 0x17:
+                    state = x_state.XWAIT
+                    length = 6
+                case 0x18:
+                    state = x_state.XWAITSTATE
+                    length = 10
                 case _:
                     print(f'Unrecogized Command: 0x{itm:02X}')
                     pass
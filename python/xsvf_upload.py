@@ -1,6 +1,6 @@
 #!/usr/bin/env python3
 import sys, os, math
-import time, enum
+import time, enum, struct
 from serial import Serial
 from serial import SerialException
 
@@ -144,6 +144,252 @@ def write_xsvf(ser, data):
     expect_ok(ser)
     print(f'{bcolors.OKCYAN}Done!{bcolors.ENDC}')
 
+def set_tck(ser, hz):
+    # 'D' 'W' n B1..B4 CS: TCK rate in Hz (MSB first), 0 = power-up default
+    message = bytearray(b'DW') + bytes((4,)) + hz.to_bytes(4, byteorder='big')
+    write_with_checksum(ser, message)
+    expect_ok(ser)
+
+def read_tck(ser):
+    # 'D' 'R' CS -> requested Hz, kernel Hz, engine kHz (4+4+3 bytes) + CS
+    write_with_checksum(ser, bytearray(b'DR'))
+    data = read(ser, 12)
+    if make_checksum(data[:11]) != data[11]:
+        raise Exception('Checksum error')
+    req = int.from_bytes(data[0:4], byteorder='big')
+    tck = int.from_bytes(data[4:8], byteorder='big')
+    engine = int.from_bytes(data[8:11], byteorder='big')
+    print(f'TCK requested: {req} Hz, achieved: {tck} Hz, engine: {engine} kHz')
+    return tck
+
+def autotune_tck(ser, force=False):
+    # 'D' 'A' f CS -> IDCODE + TCK Hz (4 bytes each) + CS, answered after the queued chunks
+    write_with_checksum(ser, bytearray(b'DA') + bytes((1 if force else 0,)))
+    data = read(ser, 9)
+    if make_checksum(data[:8]) != data[8]:
+        raise Exception('Checksum error')
+    idcode = int.from_bytes(data[0:4], byteorder='big')
+    tck = int.from_bytes(data[4:8], byteorder='big')
+    if tck == 0:
+        print(f'{bcolors.WARNING}TCK auto-tune: no TAP found{bcolors.ENDC}')
+    else:
+        print(f'TCK auto-tune: IDCODE 0x{idcode:08X}, {tck} Hz')
+    return tck
+
+PROF_NAMES = ['XCOMPLETE', 'XTDOMASK', 'XSIR', 'XSDR', 'XRUNTEST', '5', '6', 'XREPEAT',
+    'XSDRSIZE', 'XSDRTDO', 'XSETSDRMASKS', 'XSDRINC', 'XSDRB', 'XSDRC', 'XSDRE',
+    'XSDRTDOB', 'XSDRTDOC', 'XSDRTDOE', 'XSTATE', 'XENDIR', 'XENDDR', 'XSIR2',
+    '22', 'XWAIT', 'XWAITSTATE',
+    'sdr', 'state_goto', 'delay', 'retry', 'idle', 'chunk']
+
+def print_profile(entries):
+    # 16 byte entries, see xsvf_prof.h: the header, then count and cycles per entry
+    head = entries[0]
+    if head[0:1] != b'P':
+        raise Exception('No profile record')
+    hz = int.from_bytes(head[4:8], byteorder='big')
+    ms = int.from_bytes(head[8:12], byteorder='big')
+    print(f'Profile over {ms} ms, {hz // 1000000} MHz:')
+    for e in entries[1:]:
+        count = int.from_bytes(e[4:8], byteorder='big')
+        cycles = int.from_bytes(e[8:16], byteorder='big')
+        if count:
+            name = PROF_NAMES[e[0]] if e[0] < len(PROF_NAMES) else str(e[0])
+            print(f'  {name:<12} {count:>10} calls {cycles * 1000000 // hz:>12} us {cycles // count:>10} cyc/call')
+
+def read_profile(ser, clear=False):
+    # 'D' 'P' f CS -> profile record (entries x 16 bytes) + CS, f=1 clears it afterwards
+    write_with_checksum(ser, bytearray(b'DP') + bytes((1 if clear else 0,)))
+    head = read(ser, 16)
+    size = head[2] * 16
+    data = head + read(ser, size - 16 + 1)
+    if make_checksum(data[:size]) != data[size]:
+        raise Exception('Checksum error')
+    entries = [data[i:i+16] for i in range(0, size, 16)]
+    if not clear:
+        print_profile(entries)
+    return entries
+
+#---------------------------------- Ostrich v2
+# frame: 0x00, COBS(type, seq, len, payload, CRC-32/MPEG-2), 0x00, see frame.h
+def crc32_mpeg2(data):
+    crc = 0xFFFFFFFF
+    for b in data:
+        crc ^= b << 24
+        for i in range(8):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else (crc << 1)
+            crc &= 0xFFFFFFFF
+    return crc
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for b in data:
+        if b == 0:
+            out += bytes((len(block) + 1,)) + block
+            block = bytearray()
+        else:
+            block.append(b)
+            if len(block) == 254:
+                out += b'\xff' + block
+                block = bytearray()
+    out += bytes((len(block) + 1,)) + block
+    return bytes(out)
+
+def cobs_decode(data):
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        out += data[pos+1:pos+code]
+        pos += code
+        if code != 0xFF and pos < len(data):
+            out.append(0)
+    return bytes(out)
+
+class Ostrich2:
+    def __init__(self, ser):
+        self.ser = ser
+        self.seq = 0
+        self.events = []
+        # a window of frames may be more than the device takes at once
+        self.ser.write_timeout = 30
+
+    def send(self, ftype, seq, payload=b''):
+        body = bytes((ord(ftype),)) + struct.pack('>HH', seq, len(payload)) + payload
+        write(self.ser, b'\x00' + cobs_encode(body + struct.pack('>I', crc32_mpeg2(body))) + b'\x00')
+
+    def receive(self):
+        # returns (type, seq, payload), broken frames are skipped
+        while True:
+            raw = bytearray()
+            while True:
+                c = self.ser.read(1)
+                if len(c) == 0:
+                    raise Exception('Read timeout')
+                if c == b'\x00':
+                    if len(raw):
+                        break
+                else:
+                    raw += c
+            body = cobs_decode(raw)
+            if len(body) < 9 or crc32_mpeg2(body[:-4]) != int.from_bytes(body[-4:], byteorder='big'):
+                print(f'{bcolors.WARNING}Broken frame from device{bcolors.ENDC}')
+                continue
+            ftype, seq, length = struct.unpack('>cHH', body[:5])
+            return ftype.decode('latin-1'), seq, body[5:-4]
+
+    def request(self, ftype, payload=b'', retries=3):
+        # sends a frame and returns the ACK payload, a NAK repeats the frame
+        seq = self.seq
+        self.seq = (self.seq + 1) & 0xFFFF
+        for attempt in range(retries):
+            self.send(ftype, seq, payload)
+            while True:
+                rtype, rseq, data = self.receive()
+                if rtype == 'E':
+                    self.events.append((rseq, data))
+                    if data == b'X':
+                        raise Exception(f'Programming Error (frame {rseq})')
+                elif rtype == 'N' or rseq == seq:
+                    # the seq of a NAK may be broken, only one frame is in flight
+                    break
+            if rtype == 'A':
+                return seq, data
+            print(f'{bcolors.WARNING}Frame {seq} refused ({data[0]}), again{bcolors.ENDC}')
+        raise Exception(f'Frame {seq} refused')
+
+    def event(self, seq):
+        # waits for the answer of the worker to the request seq
+        while True:
+            for e in self.events:
+                if e[0] == seq:
+                    self.events.remove(e)
+                    return e[1]
+            rtype, rseq, data = self.receive()
+            if rtype == 'E':
+                self.events.append((rseq, data))
+
+def set_tck_v2(o, hz):
+    o.request('D', b'W' + hz.to_bytes(4, byteorder='big'))
+
+def read_tck_v2(o):
+    seq, data = o.request('D', b'R')
+    req = int.from_bytes(data[0:4], byteorder='big')
+    tck = int.from_bytes(data[4:8], byteorder='big')
+    engine = int.from_bytes(data[8:11], byteorder='big')
+    print(f'TCK requested: {req} Hz, achieved: {tck} Hz, engine: {engine} kHz')
+    return tck
+
+def autotune_tck_v2(o, force=False):
+    seq, data = o.request('D', b'A' + bytes((1 if force else 0,)))
+    data = o.event(seq)
+    idcode = int.from_bytes(data[0:4], byteorder='big')
+    tck = int.from_bytes(data[4:8], byteorder='big')
+    if tck == 0:
+        print(f'{bcolors.WARNING}TCK auto-tune: no TAP found{bcolors.ENDC}')
+    else:
+        print(f'TCK auto-tune: IDCODE 0x{idcode:08X}, {tck} Hz')
+    return tck
+
+def read_profile_v2(o, clear=False):
+    # 'D' 'P' i f: one entry per frame, the header tells how many there are
+    seq, head = o.request('D', b'P' + bytes((0, 0)))
+    entries = [head]
+    for i in range(1, head[2]):
+        last = (i == head[2] - 1)
+        seq, data = o.request('D', b'P' + bytes((i, 1 if clear and last else 0)))
+        entries.append(data)
+    if not clear:
+        print_profile(entries)
+    return entries
+
+def upload_window(o, chunks):
+    # 'S' opens the window, chunk i is sent with seq first + i
+    seq, data = o.request('S')
+    window = data[0]
+    first = (seq + 1) & 0xFFFF
+    o.seq = (first + len(chunks)) & 0xFFFF
+    base = nxt = 0 # oldest chunk without ACK, next chunk to send
+    print(f'Window: {window} chunks')
+    while base < len(chunks):
+        while nxt < len(chunks) and nxt - base < window:
+            print(f'Writing: Index: {nxt} Length: {len(chunks[nxt])}')
+            o.send('X', (first + nxt) & 0xFFFF, chunks[nxt])
+            nxt += 1
+        try:
+            rtype, rseq, data = o.receive()
+        except Exception:
+            print(f'{bcolors.WARNING}No answer, again from chunk {base}{bcolors.ENDC}')
+            nxt = base
+            continue
+        idx = (rseq - first) & 0xFFFF
+        if rtype == 'A' and idx < nxt:
+            # cumulative, everything up to idx is queued
+            base = max(base, idx + 1)
+        elif rtype == 'N':
+            if data[0] == 8:
+                raise Exception(f'Chunk {idx} refused, the player failed')
+            if base <= idx < nxt:
+                print(f'{bcolors.WARNING}Chunk {idx} missing ({data[0]}), going back{bcolors.ENDC}')
+                base = idx
+                nxt = idx
+        elif rtype == 'E':
+            if data == b'X':
+                raise Exception(f'Programming Error (chunk {idx})')
+            o.events.append((rseq, data))
+
+def main_v2(o, f):
+    upload_window(o, split_file(f))
+    # 'F' comes from the chunk with XCOMPLETE
+    while not any(e[1] == b'F' for e in o.events):
+        rtype, rseq, data = o.receive()
+        if rtype == 'E':
+            if data == b'X':
+                raise Exception(f'Programming Error (frame {rseq})')
+            o.events.append((rseq, data))
+    print(f'{bcolors.OKCYAN}Done!{bcolors.ENDC}')
+
 def main(ser, f):
     if len(f) > 32768:
         print(f'Split file in 32k Chunks')
@@ -156,7 +402,7 @@ def main(ser, f):
 
 if __name__ == '__main__':
     if len(sys.argv) < 2:
-        print(f'{bcolors.FAIL}Usage: ./xsvf_parser.py test.xsvf{bcolors.ENDC}')
+        print(f'{bcolors.FAIL}Usage: ./xsvf_upload.py test.xsvf [tck_hz|auto] [v2] [prof]{bcolors.ENDC}')
         exit()
     os.system('clear')
     print(f'Scriptversion: {ver}')
@@ -179,7 +425,38 @@ if __name__ == '__main__':
         exit()
 
     ser.flush()
-    main(ser, f)
+    args = sys.argv[2:]
+    # cycle profile of the player for this upload
+    prof = 'prof' in args
+    if prof:
+        args.remove('prof')
+    if 'v2' in args:
+        # framed protocol
+        args.remove('v2')
+        o = Ostrich2(ser)
+        if len(args):
+            if args[0] == 'auto':
+                autotune_tck_v2(o)
+            else:
+                set_tck_v2(o, int(args[0]))
+            read_tck_v2(o)
+        if prof:
+            read_profile_v2(o, clear=True)
+        main_v2(o, f)
+        if prof:
+            read_profile_v2(o)
+    else:
+        if len(args):
+            if args[0] == 'auto':
+                autotune_tck(ser)
+            else:
+                set_tck(ser, int(args[0]))
+            read_tck(ser)
+        if prof:
+            read_profile(ser, clear=True)
+        main(ser, f)
+        if prof:
+            read_profile(ser)
     try:
         ser.close()
     except: